@@ -147,10 +147,50 @@
 #endif
 #endif
 
+#ifndef RG_TASK_QUEUE_LENGTH
+#define RG_TASK_QUEUE_LENGTH 4
+#endif
+
 #ifndef RG_ZIP_SUPPORT
 #define RG_ZIP_SUPPORT 1
 #endif
 
+// Chunk size of bulk file transfers, a multiple of the FAT cluster size avoids partial cluster accesses
+#ifndef RG_STORAGE_IO_CHUNK_SIZE
+#define RG_STORAGE_IO_CHUNK_SIZE (32 * 1024)
+#endif
+
+// Label of the flash data partition that the launcher copies ROMs to, see rg_storage_cache_rom
+#ifndef RG_STORAGE_ROM_PARTITION
+#define RG_STORAGE_ROM_PARTITION "romcache"
+#endif
+
+// Seconds that battery-backed RAM stays dirty before being written back, 0 to only write on exit
+#ifndef RG_SRAM_AUTOSAVE_DELAY
+#define RG_SRAM_AUTOSAVE_DELAY 5
+#endif
+
+// Audio frames buffered between the emulator and the audio task, must be a power of two
+#ifndef RG_AUDIO_BUFFER_LENGTH
+#define RG_AUDIO_BUFFER_LENGTH 2048
+#endif
+
+// Rewind takes a snapshot every N frames and keeps the compressed deltas in a ring of this many bytes
+#ifndef RG_REWIND_INTERVAL
+#define RG_REWIND_INTERVAL 4
+#endif
+#ifndef RG_REWIND_BUFFER_SIZE
+#define RG_REWIND_BUFFER_SIZE (512 * 1024)
+#endif
+// Combos offered for the rewind hotkey. Games still see these keys, so rewind stays off until one is picked.
+#ifndef RG_REWIND_HOTKEYS
+#define RG_REWIND_HOTKEYS {RG_KEY_SELECT | RG_KEY_LEFT, RG_KEY_SELECT | RG_KEY_B, RG_KEY_START | RG_KEY_LEFT}
+#endif
+
+#ifndef RG_DISPLAY_PROFILE_FRAMES
+#define RG_DISPLAY_PROFILE_FRAMES 120
+#endif
+
 #ifndef RG_SCREEN_PARTIAL_UPDATES
 #define RG_SCREEN_PARTIAL_UPDATES 1
 #endif
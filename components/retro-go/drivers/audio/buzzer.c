@@ -314,7 +314,7 @@ static bool buzzer_submit(const rg_audio_frame_t *frames, size_t count)
 {
     // FIXME: We should probably use globals here instead of doing three function calls per submission...
     float volumeFactor = rg_audio_get_mute() ? 0.f : (rg_audio_get_volume() * 0.01f) * BOOSTVOLUME;
-    int sampleRate = rg_audio_get_sample_rate();
+    int sampleRate = rg_audio_get_output_rate();
 
     for (size_t i = 0; i < count; ++i)
     {
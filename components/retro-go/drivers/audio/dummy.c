@@ -19,13 +19,19 @@ static bool driver_submit(const rg_audio_frame_t *frames, size_t count)
     // Wait until the previous submission is done "playing"
     if (busyUntil > rg_system_timer())
         rg_usleep(busyUntil - rg_system_timer());
-    busyUntil = rg_system_timer() + (count * (1000000.f / rg_audio_get_sample_rate()));
+    busyUntil = rg_system_timer() + (count * (1000000.f / rg_audio_get_output_rate()));
     return true;
 }
 
+static int driver_get_latency(void)
+{
+    return RG_MAX(busyUntil - rg_system_timer(), 0);
+}
+
 const rg_audio_driver_t rg_audio_driver_dummy = {
     .name = "dummy",
     .init = driver_init,
     .deinit = driver_deinit,
     .submit = driver_submit,
+    .get_latency = driver_get_latency,
 };
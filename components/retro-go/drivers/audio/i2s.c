@@ -15,10 +15,15 @@
 #include <driver/dac.h>
 #endif
 
+// Goal is to have ~800 samples over 2-8 buffers (3x270 or 5x180 are pretty good)
+#define DMA_BUF_COUNT 4
+#define DMA_BUF_LEN 180 // The unit is stereo samples (4 bytes) (optimize for 533 usage)
+
 static struct {
     const char *last_error;
     int device;
     int volume;
+    int sample_rate;
     bool muted;
 } state;
 
@@ -26,6 +31,7 @@ static bool driver_init(int device, int sample_rate)
 {
     state.last_error = NULL;
     state.device = device;
+    state.sample_rate = sample_rate;
 
     if (state.device == 0)
     {
@@ -37,8 +43,8 @@ static bool driver_init(int device, int sample_rate)
             .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
             .communication_format = I2S_COMM_FORMAT_STAND_MSB,
             .intr_alloc_flags = 0, // ESP_INTR_FLAG_LEVEL1
-            .dma_buf_count = 4, // Goal is to have ~800 samples over 2-8 buffers (3x270 or 5x180 are pretty good)
-            .dma_buf_len = 180, // The unit is stereo samples (4 bytes) (optimize for 533 usage)
+            .dma_buf_count = DMA_BUF_COUNT,
+            .dma_buf_len = DMA_BUF_LEN,
         }, 0, NULL);
         if (ret == ESP_OK)
             ret = i2s_set_dac_mode(RG_AUDIO_USE_INT_DAC);
@@ -58,8 +64,8 @@ static bool driver_init(int device, int sample_rate)
             .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
             .communication_format = I2S_COMM_FORMAT_STAND_I2S,
             .intr_alloc_flags = 0, // ESP_INTR_FLAG_LEVEL1
-            .dma_buf_count = 4, // Goal is to have ~800 samples over 2-8 buffers (3x270 or 5x180 are pretty good)
-            .dma_buf_len = 180, // The unit is stereo samples (4 bytes) (optimize for 533 usage)
+            .dma_buf_count = DMA_BUF_COUNT,
+            .dma_buf_len = DMA_BUF_LEN,
         #if CONFIG_IDF_TARGET_ESP32
             .use_apll = true, // External DAC may care about accuracy
         #endif
@@ -85,6 +91,7 @@ static bool driver_init(int device, int sample_rate)
 
 static bool driver_set_sample_rates(int sampleRate)
 {
+    state.sample_rate = sampleRate;
     return i2s_set_sample_rates(I2S_NUM_0, sampleRate) == ESP_OK;
 }
 
@@ -205,6 +212,12 @@ static const char *driver_get_error(void)
     return state.last_error;
 }
 
+static int driver_get_latency(void)
+{
+    // The DMA buffers are always full while we're playing
+    return (int64_t)(DMA_BUF_COUNT * DMA_BUF_LEN) * 1000000 / RG_MAX(state.sample_rate, 1);
+}
+
 const rg_audio_driver_t rg_audio_driver_i2s = {
     .name = "i2s",
     .init = driver_init,
@@ -214,6 +227,7 @@ const rg_audio_driver_t rg_audio_driver_i2s = {
     .set_volume = driver_set_volume,
     .set_sample_rate = driver_set_sample_rates,
     .get_error = driver_get_error,
+    .get_latency = driver_get_latency,
 };
 
 #endif // RG_AUDIO_USE_INT_DAC || RG_AUDIO_USE_EXT_DAC
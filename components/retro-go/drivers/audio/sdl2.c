@@ -9,12 +9,12 @@ static int sampleRate;
 
 static bool driver_init(int device, int _sampleRate)
 {
+    sampleRate = _sampleRate;
     SDL_AudioSpec desired = {
         .freq = sampleRate,
         .format = AUDIO_S16,
         .channels = 2,
     };
-    sampleRate = _sampleRate;
     audioDevice = SDL_OpenAudioDevice(NULL, 0, &desired, NULL, 0);
     return audioDevice != 0;
 }
@@ -29,12 +29,9 @@ static bool driver_submit(const rg_audio_frame_t *frames, size_t count)
 {
     SDL_QueueAudio(audioDevice, (void *)frames, count * 4);
     SDL_PauseAudioDevice(audioDevice, 0);
-    // This is ugly, but we must emulate how it works on the ESP32, where the audio does the pacing!
-    static int64_t frame_start = 0;
-    int64_t frame_end = frame_start + (uint32_t)(count * (1000000.f / sampleRate)) - 500;
-    if (frame_end > rg_system_timer())
-        rg_usleep((frame_end - rg_system_timer()));
-    frame_start = rg_system_timer();
+    // Block like the I2S driver does when its DMA buffers are full, SDL plays the queue at the device's rate
+    while (SDL_GetQueuedAudioSize(audioDevice) > count * 4 * 2)
+        rg_task_delay(1);
     return true;
 }
 
@@ -53,6 +50,11 @@ static const char *driver_get_error(void)
     return SDL_GetError();
 }
 
+static int driver_get_latency(void)
+{
+    return (int64_t)SDL_GetQueuedAudioSize(audioDevice) / 4 * 1000000 / sampleRate;
+}
+
 const rg_audio_driver_t rg_audio_driver_sdl2 = {
     .name = "sdl2",
     .init = driver_init,
@@ -62,6 +64,7 @@ const rg_audio_driver_t rg_audio_driver_sdl2 = {
     .set_volume = driver_set_volume,
     .set_sample_rate = NULL,
     .get_error = driver_get_error,
+    .get_latency = driver_get_latency,
 };
 
 #endif // RG_AUDIO_USE_SDL2
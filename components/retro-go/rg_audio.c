@@ -44,13 +44,42 @@ static struct
     const rg_audio_sink_t *sink;
     const rg_audio_driver_t *driver;
     rg_mutex_t *lock;
-    int sampleRate;
+    rg_task_t *task;
+    int sampleRate; // Rate of the submitted frames
+    int outputRate; // Rate of the device, it doesn't change after the first init
     int filter;
     int volume;
     bool muted;
+    bool discard;
+    bool playing;
+    int64_t lastSubmit;
 } audio;
 static rg_audio_counters_t counters;
 
+// Single producer (rg_audio_submit) single consumer (audio_task) ring buffer. The positions are
+// free running counters, only the producer writes head and only the consumer writes tail.
+static struct
+{
+    rg_audio_frame_t *buffer;
+    uint32_t head;
+    uint32_t tail;
+} ring;
+
+#define RING_MASK (RG_AUDIO_BUFFER_LENGTH - 1)
+#define RING_LOAD(pos) __atomic_load_n(&ring.pos, __ATOMIC_ACQUIRE)
+#define RING_STORE(pos, value) __atomic_store_n(&ring.pos, (value), __ATOMIC_RELEASE)
+
+// Largest chunk given to the driver at once, smaller means lower latency but more overhead
+#define AUDIO_CHUNK_LENGTH 256
+
+// Linear interpolation between the last two input frames, phase is 16.16 fixed point
+static struct
+{
+    rg_audio_frame_t prev;
+    rg_audio_frame_t next;
+    uint32_t phase;
+} resampler;
+
 static const char *SETTING_DRIVER = "AudioDriver";
 static const char *SETTING_DEVICE = "AudioDevice";
 static const char *SETTING_VOLUME = "Volume";
@@ -63,6 +92,83 @@ static const char *get_last_driver_error(void)
     return "Unspecified Error";
 }
 
+static void update_latency(size_t queued)
+{
+    int latency = (int64_t)queued * 1000000 / RG_MAX(audio.sampleRate, 1);
+    if (audio.driver->get_latency)
+        latency += audio.driver->get_latency();
+    counters.queueDepth = queued;
+    counters.latency = latency;
+    counters.latencyHistogram[RG_MIN(latency / 10000, RG_AUDIO_LATENCY_BUCKETS - 1)]++;
+}
+
+static void audio_task(void *arg)
+{
+    rg_audio_frame_t output[AUDIO_CHUNK_LENGTH];
+    rg_task_msg_t msg;
+
+    while (true)
+    {
+        uint32_t head = RING_LOAD(head);
+        uint32_t tail = ring.tail;
+
+        if (head == tail)
+        {
+            // Running dry isn't an underrun if the app has simply stopped submitting (menu, loading, etc)
+            if (audio.playing && rg_system_timer() - audio.lastSubmit < 100000)
+                counters.underruns++;
+            audio.playing = false;
+            // Wait for rg_audio_submit to notify us. The timeout covers notifications lost in a race.
+            if (rg_task_receive(&msg, 10) && msg.type == RG_TASK_MSG_STOP)
+                break;
+            continue;
+        }
+
+        // Dynamic rate control: the emulator and the audio device never run at exactly the same speed,
+        // so we stretch the audio by up to 0.5% (inaudible) to keep the buffer about half full.
+        float usage = (float)(head - tail) / RG_AUDIO_BUFFER_LENGTH;
+        float ratio = (float)audio.sampleRate / RG_MAX(audio.outputRate, 1) * (1.f + (usage - 0.5f) * 0.01f);
+        uint32_t step = ratio * 0x10000;
+        size_t count = 0;
+
+        while (count < AUDIO_CHUNK_LENGTH)
+        {
+            while (resampler.phase >= 0x10000 && tail != head)
+            {
+                resampler.prev = resampler.next;
+                resampler.next = ring.buffer[tail++ & RING_MASK];
+                resampler.phase -= 0x10000;
+            }
+            if (resampler.phase >= 0x10000)
+                break;
+            // 15 bits of phase so that the multiplication can't overflow
+            int frac = resampler.phase >> 1;
+            const rg_audio_frame_t prev = resampler.prev, next = resampler.next;
+            output[count].left = prev.left + (((next.left - prev.left) * frac) >> 15);
+            output[count].right = prev.right + (((next.right - prev.right) * frac) >> 15);
+            resampler.phase += step;
+            count++;
+        }
+
+        RING_STORE(tail, tail);
+
+        // The driver blocks until it has room for the samples, this is what paces this task
+        if (count > 0 && rg_mutex_take(audio.lock, -1))
+        {
+            if (audio.driver)
+            {
+                int64_t start = rg_system_timer();
+                audio.driver->submit(output, count);
+                counters.driverTime += rg_system_timer() - start;
+                counters.driverCalls++;
+                update_latency(head - tail);
+            }
+            RELEASE_DEVICE();
+            audio.playing = true;
+        }
+    }
+}
+
 void rg_audio_init(int sampleRate)
 {
     RG_ASSERT(audio.sink == NULL, "Audio sink already initialized!");
@@ -72,6 +178,11 @@ void rg_audio_init(int sampleRate)
         audio.lock = rg_mutex_create();
         RELEASE_DEVICE();
     }
+    if (!ring.buffer)
+    {
+        ring.buffer = rg_alloc(RG_AUDIO_BUFFER_LENGTH * sizeof(rg_audio_frame_t), MEM_ANY);
+        audio.task = rg_task_create("rg_audio", &audio_task, NULL, 3 * 1024, RG_TASK_PRIORITY_7, 1);
+    }
     ACQUIRE_DEVICE(1000);
 
     char *driver_name = rg_settings_get_string(NS_GLOBAL, SETTING_DRIVER, "DEFAULT");
@@ -89,22 +200,23 @@ void rg_audio_init(int sampleRate)
     audio.filter = (int)rg_settings_get_number(NS_GLOBAL, SETTING_FILTER, 0);
     audio.volume = (int)rg_settings_get_number(NS_GLOBAL, SETTING_VOLUME, 50);
     audio.sampleRate = sampleRate;
+    audio.outputRate = audio.outputRate ?: sampleRate;
     audio.driver = audio.sink->driver;
 
-    if (audio.driver->init(audio.sink->device, sampleRate))
+    if (audio.driver->init(audio.sink->device, audio.outputRate))
     {
         if (audio.driver->set_mute)
             audio.driver->set_mute(audio.muted);
         if (audio.driver->set_volume)
             audio.driver->set_volume(audio.volume);
 
-        RG_LOGI("Audio ready. sink='%s', samplerate=%d, volume=%d\n",
-            audio.sink->name, audio.sampleRate, audio.volume);
+        RG_LOGI("Audio ready. sink='%s', samplerate=%d, output=%d, volume=%d\n",
+            audio.sink->name, audio.sampleRate, audio.outputRate, audio.volume);
     }
     else
     {
         RG_LOGE("Failed to initialize audio. sink='%s', samplerate=%d, volume=%d\n",
-            audio.sink->name, audio.sampleRate, audio.volume);
+            audio.sink->name, audio.outputRate, audio.volume);
         RG_LOGE(" - Error: %s\n", get_last_driver_error());
         audio.sink = &sinks[0]; // Switching to dummy might allow us to at least boot
         audio.driver = audio.sink->driver;
@@ -138,14 +250,44 @@ void rg_audio_submit(const rg_audio_frame_t *frames, size_t count)
     if (!audio.driver)
         return;
 
-    if (!frames || !count)
+    if (!frames || !count || audio.discard)
         return;
 
-    if (ACQUIRE_DEVICE(0))
+#ifndef RG_ENABLE_BENCHMARK // The audio task plays at the device's pace, benchmarks must run unthrottled
+    const rg_audio_frame_t *src = frames;
+    size_t remaining = count;
+    bool waited = false;
+
+    while (remaining > 0)
     {
-        audio.driver->submit(frames, count);
-        RELEASE_DEVICE();
+        uint32_t head = ring.head;
+        size_t space = RG_AUDIO_BUFFER_LENGTH - (head - RING_LOAD(tail));
+
+        if (space == 0)
+        {
+            // The buffer is full, which means that the emulator runs ahead of the audio device. Apps that
+            // don't use rg_system_tick pacing rely on this to run at the correct speed.
+            counters.overruns += !waited;
+            waited = true;
+            rg_usleep(RG_MIN(remaining, AUDIO_CHUNK_LENGTH) * 1000000 / RG_MAX(audio.sampleRate, 1000));
+            continue;
+        }
+
+        size_t chunk = RG_MIN(RG_MIN(remaining, space), RG_AUDIO_BUFFER_LENGTH - (head & RING_MASK));
+        memcpy(&ring.buffer[head & RING_MASK], src, chunk * sizeof(rg_audio_frame_t));
+        RING_STORE(head, head + chunk);
+        remaining -= chunk;
+        src += chunk;
+
+        // Wake up the audio task if it's waiting (if its queue is full then it's awake anyway)
+        rg_task_send(audio.task, &(rg_task_msg_t){0}, 0);
     }
+    audio.lastSubmit = rg_system_timer();
+#endif
+
+#ifdef RG_ENABLE_BENCHMARK
+    rg_system_benchmark_hash(true, rg_crc32(0, (const uint8_t *)frames, count * sizeof(rg_audio_frame_t)));
+#endif
 
     counters.totalSamples += count;
     counters.busyTime += rg_system_timer() - time_start;
@@ -156,6 +298,11 @@ rg_audio_counters_t rg_audio_get_counters(void)
     return counters;
 }
 
+float rg_audio_get_buffer_usage(void)
+{
+    return (float)(RING_LOAD(head) - RING_LOAD(tail)) / RG_AUDIO_BUFFER_LENGTH;
+}
+
 const char *rg_audio_get_driver(void)
 {
     if (!audio.driver)
@@ -218,6 +365,11 @@ void rg_audio_set_mute(bool mute)
     RELEASE_DEVICE();
 }
 
+void rg_audio_set_discard(bool discard)
+{
+    audio.discard = discard;
+}
+
 int rg_audio_get_sample_rate(void)
 {
     return audio.sampleRate;
@@ -230,19 +382,201 @@ void rg_audio_set_sample_rate(int sampleRate)
     if (audio.sampleRate == sampleRate)
         return;
 
-    if (audio.driver->set_sample_rate)
+    // The device keeps running at the same rate, the audio task resamples
+    audio.sampleRate = sampleRate;
+    RG_LOGI("Samplerate set to %d (output: %d)", audio.sampleRate, audio.outputRate);
+}
+
+int rg_audio_get_output_rate(void)
+{
+    return audio.outputRate;
+}
+
+// Frames mixed at once, this bounds the size of the mixer's work buffers
+#define MIXER_CHUNK_LENGTH 128
+
+typedef struct
+{
+    const void *data;
+    uint32_t count;
+    uint32_t pos;  // 16.16 fixed point
+    uint32_t step; // 16.16 fixed point
+    int32_t gain;  // 8.8 fixed point
+    rg_audio_source_format_t format;
+} rg_audio_source_t;
+
+struct rg_audio_mixer_s
+{
+    rg_mutex_t *lock;
+    int sample_rate;
+    size_t sources_count;
+    size_t sources_max;
+    int32_t mix[MIXER_CHUNK_LENGTH * 2];
+    rg_audio_frame_t output[MIXER_CHUNK_LENGTH];
+    rg_audio_source_t sources[];
+};
+
+// Linear interpolation between sample i and j, frac is 15 bits so that it can't overflow
+#define MIXER_LOOP(...)                                                    \
+    for (; n < count && (pos >> 16) < src->count; ++n, pos += src->step)  \
+    {                                                                      \
+        uint32_t i = pos >> 16, j = RG_MIN(i + 1, src->count - 1);         \
+        int frac = (pos & 0xFFFF) >> 1;                                    \
+        __VA_ARGS__                                                        \
+    }
+#define LERP(a, b) (((a) + ((((b) - (a)) * frac) >> 15)) * gain >> 8)
+
+static void mix_source(rg_audio_source_t *src, int32_t *mix, size_t count)
+{
+    const int32_t gain = src->gain;
+    uint32_t pos = src->pos;
+    size_t n = 0;
+
+    if (gain == 0)
+    {
+        // Muted sources still advance so that they stay in sync
+        pos = RG_MIN(pos + (uint64_t)src->step * count, (uint64_t)src->count << 16);
+    }
+    else if (src->format == RG_AUDIO_SOURCE_STEREO)
+    {
+        const rg_audio_frame_t *data = src->data;
+        MIXER_LOOP({
+            mix[n * 2 + 0] += LERP(data[i].left, data[j].left);
+            mix[n * 2 + 1] += LERP(data[i].right, data[j].right);
+        })
+    }
+    else if (src->format == RG_AUDIO_SOURCE_U8)
+    {
+        const uint8_t *data = src->data;
+        MIXER_LOOP({
+            int32_t sample = LERP((data[i] - 128) * 256, (data[j] - 128) * 256);
+            mix[n * 2 + 0] += sample;
+            mix[n * 2 + 1] += sample;
+        })
+    }
+    else
     {
-        if (ACQUIRE_DEVICE(1000))
+        const int16_t *data = src->data;
+        const int left = src->format != RG_AUDIO_SOURCE_RIGHT;
+        const int right = src->format != RG_AUDIO_SOURCE_LEFT;
+        MIXER_LOOP({
+            int32_t sample = LERP(data[i], data[j]);
+            mix[n * 2 + 0] += sample * left;
+            mix[n * 2 + 1] += sample * right;
+        })
+    }
+
+    if ((pos >> 16) >= src->count)
+    {
+        src->data = NULL;
+        src->pos = pos;
+        return;
+    }
+
+    // Move the data pointer up to the current sample, so that pos never overflows on long buffers
+    uint32_t consumed = pos >> 16;
+    size_t sample_size = src->format == RG_AUDIO_SOURCE_STEREO ? 4 : src->format == RG_AUDIO_SOURCE_U8 ? 1 : 2;
+    src->data = (const uint8_t *)src->data + consumed * sample_size;
+    src->count -= consumed;
+    src->pos = pos & 0xFFFF;
+}
+
+rg_audio_mixer_t *rg_audio_mixer_create(int sample_rate, size_t max_sources)
+{
+    RG_ASSERT_ARG(sample_rate > 0 && max_sources > 0);
+    size_t size = sizeof(rg_audio_mixer_t) + max_sources * sizeof(rg_audio_source_t);
+    rg_audio_mixer_t *mixer = rg_alloc(size, MEM_FAST);
+    mixer->lock = rg_mutex_create();
+    mixer->sample_rate = sample_rate;
+    mixer->sources_max = max_sources;
+    return mixer;
+}
+
+void rg_audio_mixer_free(rg_audio_mixer_t *mixer)
+{
+    if (!mixer)
+        return;
+    rg_mutex_free(mixer->lock);
+    free(mixer);
+}
+
+int rg_audio_mixer_add_source(rg_audio_mixer_t *mixer, rg_audio_source_format_t format, int sample_rate, float gain)
+{
+    RG_ASSERT_ARG(mixer);
+    if (mixer->sources_count >= mixer->sources_max)
+    {
+        RG_LOGE("Mixer is full (%d sources)", (int)mixer->sources_max);
+        return -1;
+    }
+    int source = mixer->sources_count++;
+    mixer->sources[source].format = format;
+    rg_audio_mixer_set_rate(mixer, source, sample_rate);
+    rg_audio_mixer_set_gain(mixer, source, gain);
+    return source;
+}
+
+void rg_audio_mixer_set_gain(rg_audio_mixer_t *mixer, int source, float gain)
+{
+    RG_ASSERT_ARG(mixer && source >= 0 && source < mixer->sources_count);
+    mixer->sources[source].gain = RG_MIN(RG_MAX(gain, 0.f), 64.f) * 256;
+}
+
+void rg_audio_mixer_set_rate(rg_audio_mixer_t *mixer, int source, int sample_rate)
+{
+    RG_ASSERT_ARG(mixer && source >= 0 && source < mixer->sources_count);
+    mixer->sources[source].step = (uint64_t)sample_rate * 0x10000 / mixer->sample_rate;
+}
+
+void rg_audio_mixer_write(rg_audio_mixer_t *mixer, int source, const void *samples, size_t count)
+{
+    RG_ASSERT_ARG(mixer && source >= 0 && source < mixer->sources_count);
+    rg_audio_source_t *src = &mixer->sources[source];
+    rg_mutex_take(mixer->lock, -1);
+    // The fractional position is kept for continuity between consecutive buffers of a stream
+    src->data = count ? samples : NULL;
+    src->count = count;
+    src->pos &= 0xFFFF;
+    rg_mutex_give(mixer->lock);
+}
+
+bool rg_audio_mixer_is_playing(rg_audio_mixer_t *mixer, int source)
+{
+    RG_ASSERT_ARG(mixer && source >= 0 && source < mixer->sources_count);
+    return mixer->sources[source].data != NULL;
+}
+
+void rg_audio_mixer_render(rg_audio_mixer_t *mixer, rg_audio_frame_t *frames, size_t count)
+{
+    RG_ASSERT_ARG(mixer && frames);
+    rg_mutex_take(mixer->lock, -1);
+    while (count > 0)
+    {
+        size_t chunk = RG_MIN(count, MIXER_CHUNK_LENGTH);
+        memset(mixer->mix, 0, chunk * 2 * sizeof(int32_t));
+        for (size_t i = 0; i < mixer->sources_count; ++i)
         {
-            audio.driver->set_sample_rate(sampleRate);
-            audio.sampleRate = sampleRate;
-            RG_LOGI("Samplerate set to %d", audio.sampleRate);
-            RELEASE_DEVICE();
+            if (mixer->sources[i].data)
+                mix_source(&mixer->sources[i], mixer->mix, chunk);
         }
+        for (size_t i = 0; i < chunk; ++i)
+        {
+            frames[i].left = RG_MIN(RG_MAX(mixer->mix[i * 2 + 0], -32768), 32767);
+            frames[i].right = RG_MIN(RG_MAX(mixer->mix[i * 2 + 1], -32768), 32767);
+        }
+        frames += chunk;
+        count -= chunk;
     }
-    else
+    rg_mutex_give(mixer->lock);
+}
+
+void rg_audio_mixer_submit(rg_audio_mixer_t *mixer, size_t count)
+{
+    RG_ASSERT_ARG(mixer);
+    while (count > 0)
     {
-        rg_audio_deinit();
-        rg_audio_init(sampleRate);
+        size_t chunk = RG_MIN(count, MIXER_CHUNK_LENGTH);
+        rg_audio_mixer_render(mixer, mixer->output, chunk);
+        rg_audio_submit(mixer->output, chunk);
+        count -= chunk;
     }
 }
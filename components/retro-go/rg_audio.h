@@ -21,6 +21,7 @@ typedef struct
     bool (*set_volume)(int percent);                              // Optional
     bool (*set_sample_rate)(int sample_rate);                     // Optional
     const char *(*get_error)(void);                               // Optional
+    int (*get_latency)(void);                                     // Optional, microseconds queued in the device
 } rg_audio_driver_t;
 
 typedef struct
@@ -30,16 +31,27 @@ typedef struct
     const char *name;
 } rg_audio_sink_t;
 
+#define RG_AUDIO_LATENCY_BUCKETS 8 // 10ms each, the last one also counts everything above
+
 typedef struct
 {
     int64_t totalSamples;
-    int64_t busyTime;
+    int64_t busyTime;   // Time spent in rg_audio_submit
+    int64_t driverTime; // Time spent in the driver's submit, including the time it blocks
+    int64_t driverCalls;
+    int32_t underruns;  // The audio task ran out of frames while the app was submitting
+    int32_t overruns;   // rg_audio_submit had to wait for room in the buffer
+    int32_t queueDepth; // Frames waiting in the buffer
+    int32_t latency;    // Estimated time before a submitted frame is heard, in microseconds
+    uint32_t latencyHistogram[RG_AUDIO_LATENCY_BUCKETS];
 } rg_audio_counters_t;
 
 void rg_audio_init(int sample_rate);
 void rg_audio_deinit(void);
 void rg_audio_submit(const rg_audio_frame_t *frames, size_t count);
 rg_audio_counters_t rg_audio_get_counters(void);
+// Fill level of the buffer between rg_audio_submit and the audio device, from 0.0 (empty) to 1.0 (full)
+float rg_audio_get_buffer_usage(void);
 
 // const char **rg_audio_get_drivers(void);
 const char *rg_audio_get_driver(void);
@@ -52,5 +64,36 @@ int rg_audio_get_volume(void);
 void rg_audio_set_volume(int percent);
 bool rg_audio_get_mute(void);
 void rg_audio_set_mute(bool mute);
+// While discarding, rg_audio_submit drops everything (used for speculative frames)
+void rg_audio_set_discard(bool discard);
+// The sample rate is the rate of the frames given to rg_audio_submit, they are resampled to the output rate
 int rg_audio_get_sample_rate(void);
 void rg_audio_set_sample_rate(int sample_rate);
+int rg_audio_get_output_rate(void);
+
+// The mixer resamples and mixes several sources (one per sound chip or voice) at their native rates.
+// Samples are fixed point, the sum saturates. A source with a gain of 0 isn't mixed but its position still advances.
+typedef struct rg_audio_mixer_s rg_audio_mixer_t;
+
+typedef enum
+{
+    RG_AUDIO_SOURCE_MONO,   // int16_t samples, played on both channels
+    RG_AUDIO_SOURCE_LEFT,   // int16_t samples, played on the left channel only
+    RG_AUDIO_SOURCE_RIGHT,  // int16_t samples, played on the right channel only
+    RG_AUDIO_SOURCE_STEREO, // rg_audio_frame_t
+    RG_AUDIO_SOURCE_U8,     // uint8_t samples centered on 128, played on both channels
+} rg_audio_source_format_t;
+
+rg_audio_mixer_t *rg_audio_mixer_create(int sample_rate, size_t max_sources);
+void rg_audio_mixer_free(rg_audio_mixer_t *mixer);
+// Returns the source id, or -1 if the mixer is full
+int rg_audio_mixer_add_source(rg_audio_mixer_t *mixer, rg_audio_source_format_t format, int sample_rate, float gain);
+void rg_audio_mixer_set_gain(rg_audio_mixer_t *mixer, int source, float gain);
+void rg_audio_mixer_set_rate(rg_audio_mixer_t *mixer, int source, int sample_rate);
+// Queue samples on a source, replacing what's left of the previous ones. They must remain valid until played.
+void rg_audio_mixer_write(rg_audio_mixer_t *mixer, int source, const void *samples, size_t count);
+bool rg_audio_mixer_is_playing(rg_audio_mixer_t *mixer, int source);
+// Mix the next count frames at the mixer's sample rate, sources that run out are silent
+void rg_audio_mixer_render(rg_audio_mixer_t *mixer, rg_audio_frame_t *frames, size_t count);
+// Same as rg_audio_mixer_render followed by rg_audio_submit
+void rg_audio_mixer_submit(rg_audio_mixer_t *mixer, size_t count);
@@ -12,10 +12,67 @@ static rg_display_counters_t counters;
 static rg_display_config_t config;
 static rg_surface_t *osd;
 static rg_surface_t *border;
+static const rg_surface_t *last_update; // Last frame submitted by the emulator, see rg_display_capture
 static rg_display_t display;
-static int16_t map_viewport_to_source_x[RG_SCREEN_WIDTH + 1];
 static int16_t map_viewport_to_source_y[RG_SCREEN_HEIGHT + 1];
 static uint32_t screen_line_checksum[RG_SCREEN_HEIGHT + 1];
+static uint32_t dirty_lines_buffers[2][RG_DISPLAY_DIRTY_LINES_MAX / 32];
+static uint32_t front_dirty_lines[RG_DISPLAY_DIRTY_LINES_MAX / 32]; // Copy of mailbox.dirty_lines for the display task
+
+enum
+{
+    DISPLAY_MSG_UPDATE = 0,     // dataPtr is the surface to draw
+    DISPLAY_MSG_UPDATE_DIRTY_0, // Same, with dirty_lines_buffers[0]
+    DISPLAY_MSG_UPDATE_DIRTY_1, // Same, with dirty_lines_buffers[1]
+    DISPLAY_MSG_MAILBOX,        // Draw the latest frame from the mailbox
+    DISPLAY_MSG_OSD,            // Redraw only the OSD rows of dataPtr, see rg_display_refresh_osd
+};
+
+// Triple buffering, see rg_display_swap
+static struct
+{
+    rg_surface_t *free;    // Not used by anyone, given to the emulator on the next swap
+    rg_surface_t *ready;   // Latest complete frame, not picked up by the display task yet
+    rg_surface_t *front;   // Frame being drawn (or last drawn) by the display task
+    bool signaled;         // A DISPLAY_MSG_MAILBOX is already queued
+    volatile bool drawing; // The display task is drawing front (polled by rg_display_sync)
+    bool has_dirty_lines;  // dirty_lines is valid for ready
+    uint32_t dirty_lines[RG_DISPLAY_DIRTY_LINES_MAX / 32]; // Lines changed since front, including dropped frames
+    rg_mutex_t *lock;
+} mailbox;
+
+// Ring buffer of the timings of the last frames drawn, see rg_display_get_profile
+static struct
+{
+    rg_display_profile_t frames[RG_DISPLAY_PROFILE_FRAMES];
+    size_t count; // Total number of frames recorded
+    bool enabled;
+} profiler;
+
+// The time elapsed since the previous mark is attributed to the given stage of the current frame's profile
+#define PROFILE_MARK(stage)                          \
+    if (profile)                                     \
+    {                                                \
+        int64_t now = rg_system_timer();             \
+        profile->stage += now - profile_mark;        \
+        profile_mark = now;                          \
+    }
+
+typedef enum
+{
+    SCALER_MODE_1X = 0,  // 1:1 copy
+    SCALER_MODE_INTEGER, // Every source pixel is repeated scaler_factor times
+    SCALER_MODE_MAPPED,  // Anything else, scaler_map gives the source pixel of every screen pixel
+    SCALER_MODE_COUNT,
+} scaler_mode_t;
+
+// Horizontal scaling is precomputed in update_viewport_scaling, vertical scaling is done by repeating lines
+static int16_t scaler_map[RG_SCREEN_WIDTH + 1];
+static int16_t scaler_blend[RG_SCREEN_WIDTH + 1]; // Screen pixels to blend when filter_x is enabled
+static size_t scaler_blend_count;
+static scaler_mode_t scaler_mode;
+static int scaler_factor;
+static int scaler_width;
 
 #define LINE_IS_REPEATED(Y) (map_viewport_to_source_y[(Y)] == map_viewport_to_source_y[(Y) - 1])
 // This is to avoid flooring a number that is approximated to .9999999 and be explicit about it
@@ -63,11 +120,59 @@ static inline unsigned blend_pixels(unsigned a, unsigned b)
     // return (((a ^ b) & 0b1101111011110110U) >> 1) + (a & b);
 }
 
-static inline void write_update(const rg_surface_t *update)
+#define PIXEL_PAL565(v) (palette[(v)])
+#define PIXEL_565_LE(v) ((uint16_t)(((v) << 8) | ((v) >> 8)))
+#define PIXEL_565_BE(v) (v)
+
+// Line renderers convert one source line to scaler_width screen pixels (565 BE)
+#define DEFINE_LINE_RENDERERS(FORMAT, PTR_TYPE)                                                                   \
+    static void render_line_##FORMAT##_1x(uint16_t *restrict dst, const void *line, const uint16_t *palette)      \
+    {                                                                                                             \
+        const PTR_TYPE *src = line;                                                                               \
+        const int width = scaler_width;                                                                           \
+        for (int x = 0; x < width; ++x)                                                                           \
+            dst[x] = PIXEL_##FORMAT(src[x]);                                                                      \
+    }                                                                                                             \
+    static void render_line_##FORMAT##_integer(uint16_t *restrict dst, const void *line, const uint16_t *palette) \
+    {                                                                                                             \
+        const PTR_TYPE *src = line;                                                                               \
+        const int factor = scaler_factor;                                                                         \
+        int remaining = scaler_width;                                                                             \
+        for (; remaining >= factor; remaining -= factor, ++src)                                                   \
+        {                                                                                                         \
+            uint16_t pixel = PIXEL_##FORMAT(*src);                                                                \
+            for (int n = 0; n < factor; ++n)                                                                      \
+                *dst++ = pixel;                                                                                   \
+        }                                                                                                         \
+        while (remaining-- > 0)                                                                                   \
+            *dst++ = PIXEL_##FORMAT(*src);                                                                        \
+    }                                                                                                             \
+    static void render_line_##FORMAT##_mapped(uint16_t *restrict dst, const void *line, const uint16_t *palette)  \
+    {                                                                                                             \
+        const PTR_TYPE *src = line;                                                                               \
+        const int16_t *map = scaler_map;                                                                          \
+        const int width = scaler_width;                                                                           \
+        for (int x = 0; x < width; ++x)                                                                           \
+            dst[x] = PIXEL_##FORMAT(src[map[x]]);                                                                 \
+    }
+
+DEFINE_LINE_RENDERERS(PAL565, uint8_t)
+DEFINE_LINE_RENDERERS(565_LE, uint16_t)
+DEFINE_LINE_RENDERERS(565_BE, uint16_t)
+
+typedef void (*line_renderer_t)(uint16_t *dst, const void *line, const uint16_t *palette);
+
+static const line_renderer_t line_renderers[3][SCALER_MODE_COUNT] = {
+    {&render_line_PAL565_1x, &render_line_PAL565_integer, &render_line_PAL565_mapped},
+    {&render_line_565_LE_1x, &render_line_565_LE_integer, &render_line_565_LE_mapped},
+    {&render_line_565_BE_1x, &render_line_565_BE_integer, &render_line_565_BE_mapped},
+};
+
+static inline void write_update(const rg_surface_t *update, const uint32_t *dirty_lines, bool osd_only, rg_display_profile_t *profile)
 {
     const int64_t time_start = rg_system_timer();
+    int64_t profile_mark = time_start;
 
-    bool filter_x = display.viewport.filter_x;
     bool filter_y = display.viewport.filter_y;
     int draw_left = display.viewport.left;
     int draw_top = display.viewport.top;
@@ -95,9 +200,21 @@ static inline void write_update(const rg_surface_t *update)
     const int stride = update->stride;
     const void *data = update->data + update->offset + (crop_top * stride) + (crop_left * RG_PIXEL_GET_SIZE(format));
     const uint16_t *palette = update->palette;
+    const line_renderer_t render_line = line_renderers[(format & RG_PIXEL_PALETTE) ? 0 : (format == RG_PIXEL_565_LE ? 1 : 2)][scaler_mode];
 
     const bool partial_update = RG_SCREEN_PARTIAL_UPDATES;
 
+    // The OSD is anchored at the bottom left of the visible part of the viewport
+    const rg_surface_t *osd_surface = osd;
+    const int osd_width = osd_surface ? RG_MIN(osd_surface->width, draw_width) : 0;
+    const int osd_top = osd_surface ? draw_height - RG_MIN(osd_surface->height, draw_height) : draw_height;
+    #define OSD_ROW(y) ((const uint16_t *)(osd_surface->data + osd_surface->offset + \
+        (osd_surface->height - (draw_height - (y))) * osd_surface->stride))
+
+    // A screen line must be redrawn if its source line changed, if it was invalidated, or if it has OSD
+    #define LINE_IS_DIRTY(y) ((y) >= osd_top || (!osd_only && (screen_line_checksum[draw_top + (y)] == 0 || \
+        (dirty_lines[(crop_top + map_viewport_to_source_y[(y)]) >> 5] & (1u << ((crop_top + map_viewport_to_source_y[(y)]) & 31))))))
+
     int lines_per_buffer = LCD_BUFFER_LENGTH / draw_width;
     int lines_remaining = draw_height;
     int lines_updated = 0;
@@ -118,8 +235,25 @@ static inline void write_update(const rg_surface_t *update)
                 --lines_to_copy;
         }
 
+        // When the source tells us which lines changed we can skip entire blocks without rendering them
+        if ((dirty_lines || osd_only) && partial_update)
+        {
+            bool dirty = false;
+            for (int i = 0; i < lines_to_copy && !dirty; ++i)
+                dirty = LINE_IS_DIRTY(y + i);
+            PROFILE_MARK(checksum);
+            if (!dirty)
+            {
+                lines_remaining -= lines_to_copy;
+                y += lines_to_copy;
+                continue;
+            }
+        }
+
+        // Getting a buffer may have to wait for a previous transfer to complete
         uint16_t *line_buffer = lcd_get_buffer(LCD_BUFFER_LENGTH);
         uint16_t *line_buffer_ptr = line_buffer;
+        PROFILE_MARK(send);
 
         uint32_t checksum = 0xFFFFFFFF;
         bool need_update = !partial_update;
@@ -130,49 +264,48 @@ static inline void write_update(const rg_surface_t *update)
             {
                 memcpy(line_buffer_ptr, line_buffer_ptr - draw_width, draw_width * 2);
                 line_buffer_ptr += draw_width;
+                PROFILE_MARK(render);
             }
             else
             {
-                #define RENDER_LINE(PTR_TYPE, PIXEL) { \
-                    PTR_TYPE *buffer = (PTR_TYPE *)(data + map_viewport_to_source_y[y] * stride);\
-                    for (int xx = 0; xx < draw_width; ++xx) { \
-                        int x = map_viewport_to_source_x[xx]; \
-                        *line_buffer_ptr++ = (PIXEL); \
-                    } \
-                }
-                if (format & RG_PIXEL_PALETTE)
-                    RENDER_LINE(uint8_t, palette[buffer[x]])
-                else if (format == RG_PIXEL_565_LE)
-                    RENDER_LINE(uint16_t, (buffer[x] << 8) | (buffer[x] >> 8))
-                else
-                    RENDER_LINE(uint16_t, buffer[x])
+                render_line(line_buffer_ptr, data + map_viewport_to_source_y[y] * stride, palette);
+
+                line_buffer_ptr += draw_width;
+                PROFILE_MARK(render);
 
                 if (partial_update)
                 {
-                    checksum = rg_hash((void*)(line_buffer_ptr - draw_width), draw_width * 2);
+                    if (dirty_lines && !LINE_IS_DIRTY(y))
+                        checksum = screen_line_checksum[draw_top + y];
+                    else
+                        checksum = rg_hash((void*)(line_buffer_ptr - draw_width), draw_width * 2);
                 }
             }
 
-            if (screen_line_checksum[draw_top + y] != checksum)
+            // The OSD is drawn last (after the filters) but it must be part of the checksum
+            uint32_t line_checksum = checksum;
+            if (y >= osd_top && partial_update)
+                line_checksum += rg_hash((void *)OSD_ROW(y), osd_width * 2);
+
+            if (screen_line_checksum[draw_top + y] != line_checksum)
             {
-                screen_line_checksum[draw_top + y] = checksum;
+                screen_line_checksum[draw_top + y] = line_checksum;
                 need_update = true;
             }
+            PROFILE_MARK(checksum);
 
             ++y;
         }
 
-        if (filter_x && need_update)
+        if (scaler_blend_count && need_update)
         {
             for (int i = 0; i < lines_to_copy; ++i)
             {
                 uint16_t *buffer = line_buffer + i * draw_width;
-                for (int x = 1; x < draw_width - 1; ++x)
+                for (size_t n = 0; n < scaler_blend_count; ++n)
                 {
-                    if (map_viewport_to_source_x[x] == map_viewport_to_source_x[x - 1])
-                    {
-                        buffer[x] = blend_pixels(buffer[x - 1], buffer[x + 1]);
-                    }
+                    int x = scaler_blend[n];
+                    buffer[x] = blend_pixels(buffer[x - 1], buffer[x + 1]);
                 }
             }
         }
@@ -195,6 +328,22 @@ static inline void write_update(const rg_surface_t *update)
             }
         }
 
+        if (y > osd_top && need_update)
+        {
+            int top = y - lines_to_copy;
+            for (int i = RG_MAX(osd_top - top, 0); i < lines_to_copy; ++i)
+            {
+                const uint16_t *src = OSD_ROW(top + i);
+                uint16_t *dst = line_buffer + i * draw_width;
+                for (int x = 0; x < osd_width; ++x)
+                {
+                    if (src[x] != C_TRANSPARENT)
+                        dst[x] = (src[x] << 8) | (src[x] >> 8);
+                }
+            }
+        }
+        PROFILE_MARK(filter);
+
         if (need_update)
         {
             int left = display.screen.margins.left + draw_left;
@@ -210,15 +359,13 @@ static inline void write_update(const rg_surface_t *update)
             // Return unused buffer
             lcd_send_buffer(line_buffer, 0);
         }
+        PROFILE_MARK(send);
 
         lines_remaining -= lines_to_copy;
     }
 
-    if (osd != NULL)
-    {
-        // TODO: Draw on screen display. By default it should be bottom left which is fine
-        // for both virtual keyboard and info labels. Maybe make it configurable later...
-    }
+    if (profile)
+        profile->lines = lines_updated;
 
     if (lines_updated > draw_height * 0.80f)
         counters.fullFrames++;
@@ -275,24 +422,109 @@ static void update_viewport_scaling(void)
 
     memset(screen_line_checksum, 0, sizeof(screen_line_checksum));
 
-    for (int x = 0; x < screen_width; ++x)
-        map_viewport_to_source_x[x] = FLOAT_TO_INT(x * display.viewport.step_x);
     for (int y = 0; y < screen_height; ++y)
         map_viewport_to_source_y[y] = FLOAT_TO_INT(y * display.viewport.step_y);
 
+    // Only the part of the viewport that is visible is mapped (see write_update's cropping)
+    scaler_width = display.viewport.width + RG_MIN(display.viewport.left, 0) * 2;
+    scaler_blend_count = 0;
+    for (int x = 0; x < scaler_width; ++x)
+    {
+        scaler_map[x] = FLOAT_TO_INT(x * display.viewport.step_x);
+        if (display.viewport.filter_x && x > 0 && x < scaler_width - 1 && scaler_map[x] == scaler_map[x - 1])
+            scaler_blend[scaler_blend_count++] = x;
+    }
+
+    // Pick the fastest line renderer that gives the same result as scaler_map
+    scaler_factor = 1;
+    while (scaler_factor < scaler_width && scaler_map[scaler_factor] == 0)
+        scaler_factor++;
+    scaler_mode = scaler_factor > 1 ? SCALER_MODE_INTEGER : SCALER_MODE_1X;
+    for (int x = 0; x < scaler_width; ++x)
+    {
+        if (scaler_map[x] != x / scaler_factor)
+        {
+            scaler_mode = SCALER_MODE_MAPPED;
+            break;
+        }
+    }
+
     RG_LOGI("%dx%d@%.3f => %dx%d@%.3f left:%d top:%d step_x:%.2f step_y:%.2f", src_width, src_height,
             (float)src_width / src_height, new_width, new_height, (float)new_width / new_height,
             display.viewport.left, display.viewport.top, display.viewport.step_x, display.viewport.step_y);
 }
 
+static void get_border_cache_path(char *buffer, size_t buffer_len, const char *filename)
+{
+    // One cache file per border, a newer border or another screen size overwrites it
+    uint32_t crc = rg_crc32(0, (const uint8_t *)filename, strlen(filename));
+    snprintf(buffer, buffer_len, "%s/border_%08X.raw", RG_BASE_PATH_CACHE, (unsigned)crc);
+}
+
+// The cache is the source's mtime followed by the RAW565 format understood by rg_surface_load_image
+// (uint16 width, uint16 height, uint16 data[]). The mtime and size must match the current ones.
+static rg_surface_t *load_border_cache(const char *path, uint32_t mtime)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    uint32_t key;
+    uint16_t header[2];
+    rg_surface_t *surface = NULL;
+    if (fread(&key, sizeof(key), 1, fp) && key == mtime && fread(header, sizeof(header), 1, fp)
+        && header[0] == rg_display_get_width() && header[1] == rg_display_get_height())
+    {
+        surface = rg_surface_create(header[0], header[1], RG_PIXEL_565_LE, 0);
+        if (surface && !fread(surface->data, surface->height * surface->stride, 1, fp))
+            rg_surface_free(surface), surface = NULL;
+    }
+    fclose(fp);
+    return surface;
+}
+
+static void save_border_cache(const char *path, uint32_t mtime, const rg_surface_t *surface)
+{
+    rg_storage_mkdir(RG_BASE_PATH_CACHE);
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return;
+
+    uint16_t header[2] = {surface->width, surface->height};
+    bool success = fwrite(&mtime, sizeof(mtime), 1, fp) && fwrite(header, sizeof(header), 1, fp);
+    for (int y = 0; y < surface->height && success; ++y)
+        success = fwrite(surface->data + surface->offset + y * surface->stride, surface->width * 2, 1, fp);
+    fclose(fp);
+
+    if (!success)
+    {
+        RG_LOGW("Failed to write border cache '%s'", path);
+        rg_storage_delete(path);
+    }
+}
+
 static bool load_border_file(const char *filename)
 {
     RG_LOGI("Loading border file: %s", filename ?: "(none)");
 
-    free(border), border = NULL;
+    rg_surface_free(border), border = NULL;
     display.changed = true;
 
-    if (filename && (border = rg_surface_load_image_file(filename, 0)))
+    if (!filename)
+        return false;
+
+    char cache_path[RG_PATH_MAX + 1];
+    get_border_cache_path(cache_path, sizeof(cache_path), filename);
+    uint32_t mtime = rg_storage_stat(filename).mtime;
+
+    // Decoding and resizing a PNG is slow, we keep the result ready to send to the screen
+    if ((border = load_border_cache(cache_path, mtime)))
+    {
+        RG_LOGI("Using cached border '%s'", cache_path);
+        return true;
+    }
+
+    if ((border = rg_surface_load_image_file(filename, 0)))
     {
         if (border->width != rg_display_get_width() || border->height != rg_display_get_height())
         {
@@ -303,22 +535,79 @@ static bool load_border_file(const char *filename)
                 border = resized;
             }
         }
+        if (border->width == rg_display_get_width() && border->height == rg_display_get_height())
+            save_border_cache(cache_path, mtime, border);
         return true;
     }
     return false;
 }
 
+static void draw_border(void)
+{
+    // Only the parts of the screen that the viewport doesn't cover need to be drawn
+    int left = RG_MIN(RG_MAX(display.viewport.left, 0), border->width);
+    int top = RG_MIN(RG_MAX(display.viewport.top, 0), border->height);
+    int right = RG_MAX(RG_MIN(display.viewport.left + display.viewport.width, border->width), left);
+    int bottom = RG_MAX(RG_MIN(display.viewport.top + display.viewport.height, border->height), top);
+    const struct {int left, top, width, height;} rects[] = {
+        {0, 0, border->width, top},                         // Top
+        {0, bottom, border->width, border->height - bottom}, // Bottom
+        {0, top, left, bottom - top},                       // Left
+        {right, top, border->width - right, bottom - top},  // Right
+    };
+
+    for (size_t i = 0; i < RG_COUNT(rects); ++i)
+    {
+        if (rects[i].width > 0 && rects[i].height > 0)
+        {
+            const void *data = border->data + border->offset + rects[i].top * border->stride + rects[i].left * 2;
+            rg_display_write_rect(rects[i].left, rects[i].top, rects[i].width, rects[i].height, border->stride, data,
+                                  RG_DISPLAY_WRITE_NOSYNC);
+        }
+    }
+}
+
 IRAM_ATTR
 static void display_task(void *arg)
 {
     rg_task_msg_t msg;
 
-    while (rg_task_peek(&msg))
+    while (rg_task_peek(&msg, -1))
     {
         // Received a shutdown request!
         if (msg.type == RG_TASK_MSG_STOP)
             break;
 
+        const rg_surface_t *update = msg.dataPtr;
+        const uint32_t *dirty_lines = NULL;
+
+        if (msg.type == DISPLAY_MSG_MAILBOX)
+        {
+            rg_mutex_take(mailbox.lock, -1);
+            if (mailbox.ready)
+            {
+                mailbox.free = mailbox.front;
+                mailbox.front = mailbox.ready;
+                mailbox.ready = NULL;
+            }
+            update = mailbox.front;
+            if (mailbox.has_dirty_lines)
+            {
+                memcpy(front_dirty_lines, mailbox.dirty_lines, (update->height + 31) / 32 * 4);
+                dirty_lines = front_dirty_lines;
+            }
+            mailbox.has_dirty_lines = false;
+            mailbox.signaled = false;
+            mailbox.drawing = true;
+            // Dequeue now so that the next frame can be signaled while we're drawing this one
+            rg_task_receive(&msg, -1);
+            rg_mutex_give(mailbox.lock);
+        }
+        else if (msg.type == DISPLAY_MSG_UPDATE_DIRTY_0 || msg.type == DISPLAY_MSG_UPDATE_DIRTY_1)
+        {
+            dirty_lines = dirty_lines_buffers[msg.type - DISPLAY_MSG_UPDATE_DIRTY_0];
+        }
+
         if (display.changed)
         {
             update_viewport_scaling();
@@ -326,18 +615,32 @@ static void display_task(void *arg)
             if (display.viewport.width < display.screen.width || display.viewport.height < display.screen.height)
             {
                 if (border)
-                    rg_display_write_rect(0, 0, border->width, border->height, 0, border->data, RG_DISPLAY_WRITE_NOSYNC);
+                    draw_border();
                 else
                     rg_display_clear_except(display.viewport.left, display.viewport.top, display.viewport.width, display.viewport.height, C_BLACK);
             }
             display.changed = false;
         }
 
-        write_update(msg.dataPtr);
+        rg_display_profile_t *profile = NULL;
+        if (profiler.enabled)
+        {
+            profile = &profiler.frames[profiler.count % RG_DISPLAY_PROFILE_FRAMES];
+            *profile = (rg_display_profile_t){.frame = counters.totalFrames};
+        }
+
+        write_update(update, dirty_lines, msg.type == DISPLAY_MSG_OSD, profile);
 
-        rg_task_receive(&msg);
+        if (msg.type == DISPLAY_MSG_MAILBOX)
+            mailbox.drawing = false;
+        else
+            rg_task_receive(&msg, -1);
 
+        int64_t profile_mark = profile ? rg_system_timer() : 0;
         lcd_sync();
+        PROFILE_MARK(sync);
+        if (profile)
+            profiler.count++;
     }
 }
 
@@ -359,6 +662,55 @@ rg_display_counters_t rg_display_get_counters(void)
     return counters;
 }
 
+void rg_display_set_profiling(bool enable)
+{
+    rg_display_sync(true);
+    profiler.count = 0;
+    profiler.enabled = enable;
+}
+
+bool rg_display_get_profiling(void)
+{
+    return profiler.enabled;
+}
+
+size_t rg_display_get_profile(rg_display_profile_t *out, size_t max_frames)
+{
+    // The display task could be overwriting the oldest entries while we copy them
+    rg_display_sync(true);
+    size_t count = RG_MIN(RG_MIN(profiler.count, RG_DISPLAY_PROFILE_FRAMES), max_frames);
+    for (size_t i = 0; i < count; ++i)
+        out[i] = profiler.frames[(profiler.count - count + i) % RG_DISPLAY_PROFILE_FRAMES];
+    return count;
+}
+
+bool rg_display_save_profile(const char *filename)
+{
+    rg_display_profile_t *frames = malloc(RG_DISPLAY_PROFILE_FRAMES * sizeof(rg_display_profile_t));
+    size_t count = frames ? rg_display_get_profile(frames, RG_DISPLAY_PROFILE_FRAMES) : 0;
+    FILE *fp = NULL;
+
+    if (!count || !(fp = fopen(filename, "w")))
+    {
+        RG_LOGE("Unable to save display profile to '%s'", filename);
+        free(frames);
+        return false;
+    }
+
+    fprintf(fp, "frame,lines,render,filter,checksum,send,sync\n");
+    for (size_t i = 0; i < count; ++i)
+    {
+        const rg_display_profile_t *f = &frames[i];
+        fprintf(fp, "%d,%d,%d,%d,%d,%d,%d\n", (int)f->frame, (int)f->lines, (int)f->render, (int)f->filter,
+                (int)f->checksum, (int)f->send, (int)f->sync);
+    }
+    fclose(fp);
+    free(frames);
+
+    RG_LOGI("Saved %d frames of display profile to '%s'", (int)count, filename);
+    return true;
+}
+
 int rg_display_get_width(void)
 {
     // return display.screen.real_width - (display.screen.margins.left + display.screen.margins.right);
@@ -454,14 +806,42 @@ char *rg_display_get_border(void)
     return rg_settings_get_string(NS_APP, SETTING_BORDER, NULL);
 }
 
-void rg_display_submit(const rg_surface_t *update, uint32_t flags)
+void rg_display_set_osd(rg_surface_t *surface)
 {
-    const int64_t time_start = rg_system_timer();
+    if (surface && surface->format != RG_PIXEL_565_LE)
+    {
+        RG_LOGE("OSD surface must be RG_PIXEL_565_LE!");
+        return;
+    }
+    // The display task might be reading the current OSD
+    rg_display_sync(true);
+    // Whatever was under the previous OSD must be redrawn
+    if (osd != NULL)
+        memset(screen_line_checksum, 0, sizeof(screen_line_checksum));
+    osd = surface;
+}
 
-    // Those things should probably be asserted, but this is a new system let's be forgiving...
-    if (!update || !update->data)
+rg_surface_t *rg_display_get_osd(void)
+{
+    return osd;
+}
+
+void rg_display_refresh_osd(void)
+{
+    if (!osd || !last_update)
         return;
+    rg_display_sync(true);
+    rg_task_send(display_task_queue, &(rg_task_msg_t){.type = DISPLAY_MSG_OSD, .dataPtr = last_update}, -1);
+}
+
+void rg_display_submit(const rg_surface_t *update, uint32_t flags)
+{
+    rg_display_submit_lines(update, NULL, flags);
+}
 
+static void prepare_submit(const rg_surface_t *update)
+{
+    last_update = update;
     if (display.source.width != update->width || display.source.height != update->height)
     {
         rg_display_sync(true);
@@ -470,17 +850,118 @@ void rg_display_submit(const rg_surface_t *update, uint32_t flags)
         display.changed = true;
     }
 
-    rg_task_send(display_task_queue, &(rg_task_msg_t){.dataPtr = update});
+#ifdef RG_ENABLE_BENCHMARK
+    // Hash the source rather than the screen so results don't depend on the scaling options
+    uint32_t crc = 0;
+    for (int y = 0; y < update->height; ++y)
+        crc = rg_crc32(crc, update->data + update->offset + y * update->stride, update->width * RG_PIXEL_GET_SIZE(update->format));
+    if ((update->format & RG_PIXEL_PALETTE) && update->palette)
+        crc = rg_crc32(crc, (const uint8_t *)update->palette, 256 * 2);
+    rg_system_benchmark_hash(false, crc);
+#endif
+}
+
+void rg_display_submit_lines(const rg_surface_t *update, const uint32_t *dirty_lines, uint32_t flags)
+{
+    const int64_t time_start = rg_system_timer();
+
+    // Those things should probably be asserted, but this is a new system let's be forgiving...
+    if (!update || !update->data)
+        return;
+
+    prepare_submit(update);
+
+    // The display task might still be working on the previous frame, so we alternate between two copies
+    int type = DISPLAY_MSG_UPDATE;
+    if (dirty_lines && update->height <= RG_DISPLAY_DIRTY_LINES_MAX)
+    {
+        type = DISPLAY_MSG_UPDATE_DIRTY_0 + (counters.totalFrames & 1);
+        memcpy(dirty_lines_buffers[type - DISPLAY_MSG_UPDATE_DIRTY_0], dirty_lines, (update->height + 31) / 32 * 4);
+    }
+
+    // The emulator will reuse the previous surface as soon as we return
+    rg_display_sync(true);
+    rg_task_send(display_task_queue, &(rg_task_msg_t){.type = type, .dataPtr = update}, -1);
+
+    counters.blockTime += rg_system_timer() - time_start;
+    counters.totalFrames++;
+}
+
+rg_surface_t *rg_display_capture(int width, int height)
+{
+    if (!last_update)
+        return NULL;
+    return rg_surface_convert(last_update, width, height, RG_PIXEL_565_LE);
+}
+
+rg_surface_t *rg_display_swap_init(rg_surface_t *frames[3])
+{
+    RG_ASSERT_ARG(frames && frames[0] && frames[1] && frames[2]);
+    rg_display_sync(true);
+    rg_mutex_take(mailbox.lock, -1);
+    mailbox.free = frames[1];
+    mailbox.front = frames[2]; // It was never drawn but it's as good as free
+    mailbox.ready = NULL;
+    mailbox.has_dirty_lines = false;
+    rg_mutex_give(mailbox.lock);
+    return frames[0];
+}
+
+rg_surface_t *rg_display_swap(rg_surface_t *update, uint32_t flags)
+{
+    return rg_display_swap_lines(update, NULL, flags);
+}
+
+rg_surface_t *rg_display_swap_lines(rg_surface_t *update, const uint32_t *dirty_lines, uint32_t flags)
+{
+    const int64_t time_start = rg_system_timer();
+
+    RG_ASSERT_ARG(update && update->data);
+
+    prepare_submit(update);
+
+    if (update->height > RG_DISPLAY_DIRTY_LINES_MAX)
+        dirty_lines = NULL;
+
+    rg_mutex_take(mailbox.lock, -1);
+    // A dropped frame's changes must be merged into the next one's, the display never saw them
+    if (!dirty_lines)
+        mailbox.has_dirty_lines = false;
+    else if (!mailbox.ready)
+    {
+        memcpy(mailbox.dirty_lines, dirty_lines, (update->height + 31) / 32 * 4);
+        mailbox.has_dirty_lines = true;
+    }
+    else if (mailbox.has_dirty_lines)
+    {
+        for (int i = 0; i < (update->height + 31) / 32; ++i)
+            mailbox.dirty_lines[i] |= dirty_lines[i];
+    }
+    // If the display task hasn't picked up the previous frame yet, it is dropped and reused
+    rg_surface_t *next = mailbox.ready ? mailbox.ready : mailbox.free;
+    if (next == mailbox.free)
+        mailbox.free = NULL;
+    mailbox.ready = update;
+    bool signal = !mailbox.signaled;
+    mailbox.signaled = true;
+    rg_mutex_give(mailbox.lock);
+
+    RG_ASSERT(next, "rg_display_swap_init wasn't called");
+
+    if (signal)
+        rg_task_send(display_task_queue, &(rg_task_msg_t){.type = DISPLAY_MSG_MAILBOX}, -1);
 
     counters.blockTime += rg_system_timer() - time_start;
     counters.totalFrames++;
+
+    return next;
 }
 
 bool rg_display_sync(bool block)
 {
-    while (block && rg_task_messages_waiting(display_task_queue))
-        continue; // We should probably yield?
-    return !rg_task_messages_waiting(display_task_queue);
+    while (block && (rg_task_messages_waiting(display_task_queue) || mailbox.drawing))
+        rg_task_delay(1);
+    return !rg_task_messages_waiting(display_task_queue) && !mailbox.drawing;
 }
 
 void rg_display_write_rect(int left, int top, int width, int height, int stride, const uint16_t *buffer, uint32_t flags)
@@ -581,7 +1062,7 @@ void rg_display_clear(uint16_t color_le)
 
 void rg_display_deinit(void)
 {
-    rg_task_send(display_task_queue, &(rg_task_msg_t){.type = RG_TASK_MSG_STOP});
+    rg_task_send(display_task_queue, &(rg_task_msg_t){.type = RG_TASK_MSG_STOP}, -1);
     // lcd_set_backlight(0);
     lcd_deinit();
     RG_LOGI("Display terminated.\n");
@@ -613,6 +1094,7 @@ void rg_display_init(void)
     rg_display_clear(C_BLACK);
     rg_task_delay(80); // Wait for the screen be cleared before turning on the backlight (40ms doesn't seem to be enough...)
     lcd_set_backlight(config.backlight);
+    mailbox.lock = rg_mutex_create();
     display_task_queue = rg_task_create("rg_display", &display_task, NULL, 4 * 1024, RG_TASK_PRIORITY_6, 1);
     if (config.border_file)
         load_border_file(config.border_file);
@@ -36,6 +36,9 @@ typedef enum
     RG_DISPLAY_BACKLIGHT_MAX = 100,
 } display_backlight_t;
 
+// Maximum surface height supported by rg_display_submit_lines (taller surfaces are fully hashed)
+#define RG_DISPLAY_DIRTY_LINES_MAX 1024
+
 enum
 {
     RG_DISPLAY_WRITE_NOSYNC = (1 << 0),
@@ -61,6 +64,18 @@ typedef struct
     int64_t busyTime;
 } rg_display_counters_t;
 
+// Time spent in each stage of the display pipeline for a single frame, in microseconds
+typedef struct
+{
+    int32_t frame;    // Value of totalFrames when the frame was drawn
+    int32_t lines;    // Screen lines sent to the display
+    int32_t render;   // Pixel format conversion and scaling
+    int32_t filter;   // Filters and OSD
+    int32_t checksum; // Partial updates bookkeeping
+    int32_t send;     // lcd_send_buffer (SPI transfers), including waiting for a free buffer
+    int32_t sync;     // Waiting for the last transfer of the frame
+} rg_display_profile_t;
+
 typedef struct
 {
     const char *name;                                               // Driver name
@@ -108,8 +123,25 @@ void rg_display_clear(uint16_t color_le);
 bool rg_display_sync(bool block);
 void rg_display_force_redraw(void);
 void rg_display_submit(const rg_surface_t *update, uint32_t flags);
+// dirty_lines is a bitmap of the source lines that changed since the previous submit (bit y%32 of word y/32)
+void rg_display_submit_lines(const rg_surface_t *update, const uint32_t *dirty_lines, uint32_t flags);
+// Triple buffering: rg_display_swap never waits for the display, which always draws the latest complete frame
+// (pending older frames are dropped). It returns the surface to draw the next frame into. All three surfaces
+// must be given to rg_display_swap_init first, it returns the surface to draw the first frame into.
+rg_surface_t *rg_display_swap_init(rg_surface_t *frames[3]);
+rg_surface_t *rg_display_swap(rg_surface_t *update, uint32_t flags);
+// Same as rg_display_swap with a bitmap of the lines that changed since the previous swap (see rg_display_submit_lines)
+rg_surface_t *rg_display_swap_lines(rg_surface_t *update, const uint32_t *dirty_lines, uint32_t flags);
+// Returns a RG_PIXEL_565_LE copy of the last submitted frame scaled to width x height (0 keeps the aspect ratio)
+rg_surface_t *rg_display_capture(int width, int height);
 
 rg_display_counters_t rg_display_get_counters(void);
+// The profiler records the timings of the last RG_DISPLAY_PROFILE_FRAMES frames when enabled
+void rg_display_set_profiling(bool enable);
+bool rg_display_get_profiling(void);
+// Copies the most recent frames, oldest first, and returns how many were copied
+size_t rg_display_get_profile(rg_display_profile_t *out, size_t max_frames);
+bool rg_display_save_profile(const char *filename);
 const rg_display_t *rg_display_get_info(void);
 int rg_display_get_width(void);
 int rg_display_get_height(void);
@@ -124,5 +156,11 @@ void rg_display_set_backlight(display_backlight_t percent);
 display_backlight_t rg_display_get_backlight(void);
 void rg_display_set_border(const char *filename);
 char *rg_display_get_border(void);
+// The OSD is drawn over the bottom left of the viewport on every frame, C_TRANSPARENT pixels are skipped.
+// The surface must be RG_PIXEL_565_LE and it can be modified at any time without notifying the display.
+void rg_display_set_osd(rg_surface_t *surface);
+rg_surface_t *rg_display_get_osd(void);
+// Redraws the OSD over the last frame, for when no frames are being submitted (eg the emulator is paused)
+void rg_display_refresh_osd(void);
 void rg_display_set_custom_zoom(double factor);
 double rg_display_get_custom_zoom(void);
@@ -13,7 +13,9 @@
 
 static struct
 {
-    uint16_t *screen_buffer, *draw_buffer;
+    rg_surface_t *surface; // Drawing target, NULL is the screen
+    rg_surface_t *status_osd, *keyboard_osd, *keyboard_prev_osd;
+    uint16_t *draw_buffer;
     size_t draw_buffer_size;
     int screen_width, screen_height;
     struct {int left, top, right, bottom;} margins;
@@ -34,11 +36,13 @@ static struct
     cJSON *theme_obj;
     int font_index;
     bool show_clock;
+    bool show_status;
     bool initialized;
 } gui;
 
 #define SETTING_FONTTYPE    "FontType"
 #define SETTING_CLOCK       "Clock"
+#define SETTING_STATUS      "StatusOverlay"
 #define SETTING_THEME       "Theme"
 #define SETTING_WIFI_ENABLE "Enable"
 #define SETTING_WIFI_SLOT   "Slot"
@@ -112,6 +116,7 @@ void rg_gui_init(void)
     rg_gui_set_font(rg_settings_get_number(NS_GLOBAL, SETTING_FONTTYPE, RG_FONT_VERA_11));
     rg_gui_set_theme(rg_settings_get_string(NS_GLOBAL, SETTING_THEME, NULL));
     gui.show_clock = rg_settings_get_boolean(NS_GLOBAL, SETTING_CLOCK, false);
+    gui.show_status = rg_settings_get_boolean(NS_GLOBAL, SETTING_STATUS, false);
     gui.initialized = true;
 }
 
@@ -237,7 +242,10 @@ bool rg_gui_set_font(int index)
 
 void rg_gui_set_surface(rg_surface_t *surface)
 {
-    gui.screen_buffer = surface ? surface->data : NULL;
+    // Positions and clipping are relative to the surface while it is set
+    gui.surface = surface;
+    gui.screen_width = surface ? surface->width : rg_display_get_width();
+    gui.screen_height = surface ? surface->height : rg_display_get_height();
 }
 
 void rg_gui_copy_buffer(int left, int top, int width, int height, int stride, const void *buffer)
@@ -245,7 +253,7 @@ void rg_gui_copy_buffer(int left, int top, int width, int height, int stride, co
     left = get_horizontal_position(left, width);
     top = get_vertical_position(top, height);
 
-    if (gui.screen_buffer)
+    if (gui.surface)
     {
         if (stride < width)
             stride = width * 2;
@@ -255,7 +263,7 @@ void rg_gui_copy_buffer(int left, int top, int width, int height, int stride, co
 
         for (int y = 0; y < height; ++y)
         {
-            uint16_t *dst = gui.screen_buffer + (top + y) * gui.screen_width + left;
+            uint16_t *dst = gui.surface->data + gui.surface->offset + (top + y) * gui.surface->stride + left * 2;
             const uint16_t *src = (void *)buffer + y * stride;
             for (int x = 0; x < width; ++x)
                 if (src[x] != C_TRANSPARENT)
@@ -578,7 +586,7 @@ void rg_gui_draw_icons(void)
         struct tm *time = localtime(&time_sec);
 
         sprintf(buffer, "%02d:%02d", time->tm_hour, time->tm_min);
-        rg_gui_draw_text(x_pos, y_pos, 0, buffer, C_SILVER, gui.screen_buffer ? C_TRANSPARENT : C_BLACK, 0);
+        rg_gui_draw_text(x_pos, y_pos, 0, buffer, C_SILVER, gui.surface ? C_TRANSPARENT : C_BLACK, 0);
     }
 }
 
@@ -593,6 +601,22 @@ void rg_gui_draw_hourglass(void)
         (uint16_t*)image_hourglass.pixel_data, 0);
 }
 
+static void format_status(char *buffer, size_t max_len)
+{
+    const rg_app_t *app = rg_system_get_app();
+    rg_stats_t stats = rg_system_get_counters();
+
+    snprintf(buffer, max_len, "SPEED: %d%% (%d %d) / BUSY: %d%%",
+        (int)round(stats.totalFPS / app->tickRate * 100.f),
+        (int)round(stats.totalFPS),
+        (int)app->frameskip,
+        (int)round(stats.busyPercent));
+
+    int save_progress = rg_emu_get_save_progress();
+    if (save_progress >= 0)
+        snprintf(buffer + strlen(buffer), max_len - strlen(buffer), " / SAVING: %d%%", save_progress);
+}
+
 void rg_gui_draw_status_bars(void)
 {
     size_t max_len = gui.screen_width / 8;
@@ -600,16 +624,11 @@ void rg_gui_draw_status_bars(void)
     char footer[max_len];
 
     const rg_app_t *app = rg_system_get_app();
-    rg_stats_t stats = rg_system_get_counters();
 
     if (!app->initialized || app->isLauncher)
         return;
 
-    snprintf(header, max_len, "SPEED: %d%% (%d %d) / BUSY: %d%%",
-        (int)round(stats.totalFPS / app->tickRate * 100.f),
-        (int)round(stats.totalFPS),
-        (int)app->frameskip,
-        (int)round(stats.busyPercent));
+    format_status(header, max_len);
 
     if (app->romPath && strlen(app->romPath) > max_len - 1)
         snprintf(footer, max_len, "...%s", app->romPath + (strlen(app->romPath) - (max_len - 4)));
@@ -625,6 +644,61 @@ void rg_gui_draw_status_bars(void)
     rg_gui_draw_icons();
 }
 
+void rg_gui_set_status_overlay(bool enable)
+{
+    gui.show_status = enable;
+    rg_settings_set_boolean(NS_GLOBAL, SETTING_STATUS, enable);
+    if (!enable && gui.status_osd)
+    {
+        if (rg_display_get_osd() == gui.status_osd)
+            rg_display_set_osd(NULL);
+        rg_surface_free(gui.status_osd);
+        gui.status_osd = NULL;
+    }
+}
+
+bool rg_gui_get_status_overlay(void)
+{
+    return gui.show_status;
+}
+
+void rg_gui_update_status_overlay(void)
+{
+    const rg_app_t *app = rg_system_get_app();
+    if (!gui.show_status || !app->initialized || app->isLauncher)
+        return;
+
+    rg_surface_t *prev_surface = gui.surface;
+    rg_gui_set_surface(NULL);
+
+    char text[gui.screen_width / 8];
+    format_status(text, sizeof(text));
+
+    // The surface spans the screen width so that the text never has to be clipped
+    rg_rect_t rect = rg_gui_draw_text(0, 0, 0, text, 0, 0, RG_TEXT_DUMMY_DRAW);
+    if (gui.status_osd && gui.status_osd->height != rect.height)
+    {
+        if (rg_display_get_osd() == gui.status_osd)
+            rg_display_set_osd(NULL);
+        rg_surface_free(gui.status_osd);
+        gui.status_osd = NULL;
+    }
+    if (!gui.status_osd)
+        gui.status_osd = rg_surface_create(gui.screen_width, rect.height, RG_PIXEL_565_LE, MEM_ANY);
+
+    if (gui.status_osd)
+    {
+        rg_surface_fill(gui.status_osd, NULL, C_TRANSPARENT);
+        rg_gui_set_surface(gui.status_osd);
+        rg_gui_draw_text(0, 0, 0, text, C_WHITE, C_BLACK, 0);
+        // The virtual keyboard temporarily takes the OSD, it gives it back when it closes
+        if (!rg_display_get_osd())
+            rg_display_set_osd(gui.status_osd);
+    }
+
+    rg_gui_set_surface(prev_surface);
+}
+
 static size_t get_dialog_items_count(const rg_gui_option_t *options)
 {
     if (!options)
@@ -1056,13 +1130,45 @@ char *rg_gui_input_str(const char *title, const char *message, const char *defau
 
 void rg_gui_draw_keyboard(const rg_keyboard_map_t *map, size_t cursor)
 {
-    RG_ASSERT_ARG(map);
+    if (!map)
+    {
+        if (gui.keyboard_osd)
+        {
+            rg_display_set_osd(gui.keyboard_prev_osd);
+            rg_surface_free(gui.keyboard_osd);
+            gui.keyboard_osd = gui.keyboard_prev_osd = NULL;
+        }
+        return;
+    }
 
     int width = map->columns * 16 + 16;
     int height = map->rows * 16 + 16;
 
+    // The keyboard is drawn on the OSD, centered in the visible part of the viewport
+    const rg_display_t *display = rg_display_get_info();
+    int osd_width = RG_MAX(RG_MIN(display->viewport.width, display->screen.width), width);
+
+    if (gui.keyboard_osd && (gui.keyboard_osd->width != osd_width || gui.keyboard_osd->height != height))
+    {
+        rg_display_set_osd(gui.keyboard_prev_osd);
+        rg_surface_free(gui.keyboard_osd);
+        gui.keyboard_osd = NULL;
+    }
+    if (!gui.keyboard_osd)
+    {
+        gui.keyboard_osd = rg_surface_create(osd_width, height, RG_PIXEL_565_LE, MEM_ANY);
+        if (!gui.keyboard_osd)
+            return;
+        gui.keyboard_prev_osd = rg_display_get_osd();
+        rg_surface_fill(gui.keyboard_osd, NULL, C_TRANSPARENT);
+        rg_display_set_osd(gui.keyboard_osd);
+    }
+
+    rg_surface_t *prev_surface = gui.surface;
+    rg_gui_set_surface(gui.keyboard_osd);
+
     int x_pos = (gui.screen_width - width) / 2;
-    int y_pos = (gui.screen_height - height);
+    int y_pos = 0;
 
     char buf[2] = {0};
 
@@ -1077,6 +1183,10 @@ void rg_gui_draw_keyboard(const rg_keyboard_map_t *map, size_t cursor)
         buf[0] = map->data[i];
         rg_gui_draw_text(x + 1, y + 1, 14, buf, C_BLACK, i == cursor ? C_CYAN : C_IVORY, RG_TEXT_ALIGN_CENTER);
     }
+
+    rg_gui_set_surface(prev_surface);
+    // The emulator is paused while the keyboard is open, no frame would show the change
+    rg_display_refresh_osd();
 }
 
 static rg_gui_event_t volume_update_cb(rg_gui_option_t *option, rg_gui_event_t event)
@@ -1244,6 +1354,14 @@ static rg_gui_event_t overclock_update_cb(rg_gui_option_t *option, rg_gui_event_
     return RG_DIALOG_VOID;
 }
 
+static rg_gui_event_t display_profiling_cb(rg_gui_option_t *option, rg_gui_event_t event)
+{
+    if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
+        rg_display_set_profiling(!rg_display_get_profiling());
+    strcpy(option->value, rg_display_get_profiling() ? _("On") : _("Off"));
+    return RG_DIALOG_VOID;
+}
+
 static rg_gui_event_t speedup_update_cb(rg_gui_option_t *option, rg_gui_event_t event)
 {
     if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
@@ -1255,6 +1373,69 @@ static rg_gui_event_t speedup_update_cb(rg_gui_option_t *option, rg_gui_event_t
     return RG_DIALOG_VOID;
 }
 
+static rg_gui_event_t rewind_update_cb(rg_gui_option_t *option, rg_gui_event_t event)
+{
+    const rg_app_t *app = rg_system_get_app();
+    if (!app->handlers.saveStateMem || !app->handlers.loadStateMem)
+    {
+        option->flags = RG_DIALOG_FLAG_HIDDEN;
+        return RG_DIALOG_VOID;
+    }
+
+    const uint32_t hotkeys[] = RG_REWIND_HOTKEYS;
+    const int count = RG_COUNT(hotkeys);
+    uint32_t hotkey = rg_emu_get_rewind_hotkey();
+    int index = -1; // -1 is Off
+
+    for (int i = 0; i < count; ++i)
+        if (hotkeys[i] == hotkey)
+            index = i;
+
+    if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
+    {
+        index = (index + 1 + (event == RG_DIALOG_NEXT ? 1 : count)) % (count + 1) - 1;
+        rg_emu_set_rewind_hotkey(index < 0 ? 0 : hotkeys[index]);
+    }
+
+    if (index < 0)
+    {
+        strcpy(option->value, _("Off"));
+        return RG_DIALOG_VOID;
+    }
+
+    option->value[0] = 0;
+    for (int key = 0; key < RG_KEY_COUNT; ++key)
+    {
+        if (!(hotkeys[index] & (1 << key)))
+            continue;
+        if (option->value[0])
+            strcat(option->value, "+");
+        strcat(option->value, rg_input_get_key_name(1 << key));
+    }
+    return RG_DIALOG_VOID;
+}
+
+static rg_gui_event_t run_ahead_update_cb(rg_gui_option_t *option, rg_gui_event_t event)
+{
+    int frames = rg_emu_get_run_ahead();
+    if (frames < 0)
+    {
+        option->flags = RG_DIALOG_FLAG_HIDDEN;
+        return RG_DIALOG_VOID;
+    }
+
+    if (event == RG_DIALOG_PREV)
+        rg_emu_set_run_ahead(frames > 0 ? frames - 1 : 2);
+    if (event == RG_DIALOG_NEXT)
+        rg_emu_set_run_ahead(frames < 2 ? frames + 1 : 0);
+
+    if (rg_emu_get_run_ahead() == 0)
+        strcpy(option->value, _("Off"));
+    else
+        sprintf(option->value, "%d", rg_emu_get_run_ahead());
+    return RG_DIALOG_VOID;
+}
+
 static rg_gui_event_t led_indicator_opt_cb(rg_gui_option_t *option, rg_gui_event_t event)
 {
     if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
@@ -1292,6 +1473,14 @@ static rg_gui_event_t show_clock_cb(rg_gui_option_t *option, rg_gui_event_t even
     return RG_DIALOG_VOID;
 }
 
+static rg_gui_event_t show_status_cb(rg_gui_option_t *option, rg_gui_event_t event)
+{
+    if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
+        rg_gui_set_status_overlay(!gui.show_status);
+    strcpy(option->value, gui.show_status ? _("On") : _("Off"));
+    return RG_DIALOG_VOID;
+}
+
 static rg_gui_event_t timezone_cb(rg_gui_option_t *option, rg_gui_event_t event)
 {
     const char utc_offsets[][10] = {"UTC-12:00", "UTC-11:00", "UTC-10:00", "UTC-09:00", "UTC-09:30", "UTC-08:00",
@@ -1585,6 +1774,9 @@ void rg_gui_options_menu(void)
         {0, _("Filter"),        "-", RG_DIALOG_FLAG_NORMAL, &filter_update_cb},
         {0, _("Border"),        "-", RG_DIALOG_FLAG_NORMAL, &border_update_cb},
         {0, _("Speed"),         "-", RG_DIALOG_FLAG_NORMAL, &speedup_update_cb},
+        {0, _("Rewind"),        "-", RG_DIALOG_FLAG_NORMAL, &rewind_update_cb},
+        {0, _("Run-ahead"),     "-", RG_DIALOG_FLAG_NORMAL, &run_ahead_update_cb},
+        {0, _("Status overlay"), "-", RG_DIALOG_FLAG_NORMAL, &show_status_cb},
         // {0, _("Misc options"),  NULL, RG_DIALOG_FLAG_NORMAL, &misc_options_cb},
         {0, _("Emulator options"), NULL, RG_DIALOG_FLAG_NORMAL, &app_options_cb},
         RG_DIALOG_END,
@@ -1659,7 +1851,8 @@ void rg_gui_debug_menu(void)
     char screen_res[20], source_res[20], scaled_res[20];
     char stack_hwm[20], heap_free[20], block_free[20];
     char local_time[32], timezone[32], uptime[20];
-    char battery_info[25], frame_time[32];
+    char battery_info[25], frame_time[32], frame_stages[40];
+    char audio_queue[32], audio_xruns[32], audio_latency[40];
     char app_name[32], network_str[64];
 
     const rg_gui_option_t options[] = {
@@ -1676,6 +1869,10 @@ void rg_gui_debug_menu(void)
         {0, "Uptime    ", uptime,       RG_DIALOG_FLAG_NORMAL, NULL},
         {0, "Battery   ", battery_info, RG_DIALOG_FLAG_NORMAL, NULL},
         {0, "Blit time ", frame_time,   RG_DIALOG_FLAG_NORMAL, NULL},
+        {0, "Blit stages", frame_stages, RG_DIALOG_FLAG_NORMAL, NULL},
+        {0, "Audio queue", audio_queue, RG_DIALOG_FLAG_NORMAL, NULL},
+        {0, "Audio xruns", audio_xruns, RG_DIALOG_FLAG_NORMAL, NULL},
+        {0, "Audio delay", audio_latency, RG_DIALOG_FLAG_NORMAL, NULL},
         RG_DIALOG_SEPARATOR,
         {0, "Overclock", "-", RG_DIALOG_FLAG_NORMAL, &overclock_update_cb},
         {1, "Reboot to firmware", NULL, RG_DIALOG_FLAG_NORMAL, NULL},
@@ -1685,6 +1882,8 @@ void rg_gui_debug_menu(void)
         {5, "Cheats    ", NULL, RG_DIALOG_FLAG_NORMAL, NULL},
         {6, "Crash     ", NULL, RG_DIALOG_FLAG_NORMAL, NULL},
         {7, "Log=debug ", NULL, RG_DIALOG_FLAG_NORMAL, NULL},
+        {0, "Blit profiler", "-", RG_DIALOG_FLAG_NORMAL, &display_profiling_cb},
+        {8, "Save blit profile", NULL, RG_DIALOG_FLAG_NORMAL, NULL},
         RG_DIALOG_END
     };
 
@@ -1706,6 +1905,50 @@ void rg_gui_debug_menu(void)
     }
     else
         snprintf(frame_time, 20, "N/A");
+
+    // Average of the frames in the profiler's ring buffer: render/filter/checksum/send/sync
+    rg_display_profile_t *profile = malloc(RG_DISPLAY_PROFILE_FRAMES * sizeof(rg_display_profile_t));
+    size_t profile_frames = profile ? rg_display_get_profile(profile, RG_DISPLAY_PROFILE_FRAMES) : 0;
+    if (profile_frames > 0)
+    {
+        rg_display_profile_t sum = {0};
+        for (size_t i = 0; i < profile_frames; ++i)
+        {
+            sum.render += profile[i].render;
+            sum.filter += profile[i].filter;
+            sum.checksum += profile[i].checksum;
+            sum.send += profile[i].send;
+            sum.sync += profile[i].sync;
+        }
+        snprintf(frame_stages, 40, "%d/%d/%d/%d/%dus", (int)(sum.render / profile_frames),
+                 (int)(sum.filter / profile_frames), (int)(sum.checksum / profile_frames),
+                 (int)(sum.send / profile_frames), (int)(sum.sync / profile_frames));
+    }
+    else
+        snprintf(frame_stages, 40, "N/A");
+    free(profile);
+
+    // Latency histogram in percent, 10ms per bucket
+    rg_audio_counters_t audio_stats = rg_audio_get_counters();
+    uint32_t latency_total = 0;
+    for (size_t i = 0; i < RG_AUDIO_LATENCY_BUCKETS; ++i)
+        latency_total += audio_stats.latencyHistogram[i];
+    if (latency_total > 0)
+    {
+        char *ptr = audio_latency;
+        for (size_t i = 0; i < RG_AUDIO_LATENCY_BUCKETS; ++i)
+        {
+            int percent = (uint64_t)audio_stats.latencyHistogram[i] * 100 / latency_total;
+            ptr += sprintf(ptr, i ? "/%d" : "%d", percent);
+        }
+        strcpy(ptr, "%");
+    }
+    else
+        snprintf(audio_latency, 40, "N/A");
+    snprintf(audio_queue, 32, "%d%% %dms (%dus/call)", stats.audioQueueDepth, stats.audioLatency / 1000,
+             stats.audioSubmitTime);
+    snprintf(audio_xruns, 32, "under:%d over:%d", stats.audioUnderruns, stats.audioOverruns);
+
     snprintf(stack_hwm, 20, "%d", stats.freeStackMain);
     snprintf(heap_free, 20, "%d+%d", stats.freeMemoryInt, stats.freeMemoryExt);
     snprintf(block_free, 20, "%d+%d", stats.freeBlockInt, stats.freeBlockExt);
@@ -1753,6 +1996,9 @@ void rg_gui_debug_menu(void)
     case 7:
         rg_system_set_log_level(RG_LOG_DEBUG);
         break;
+    case 8:
+        rg_display_save_profile(RG_STORAGE_ROOT "/display.csv");
+        break;
     }
 }
 
@@ -1768,7 +2014,7 @@ static rg_gui_event_t slot_select_cb(rg_gui_option_t *option, rg_gui_event_t eve
         char buffer[100];
         if (slot->is_used)
         {
-            preview = rg_surface_load_image_file(slot->preview, 0);
+            preview = rg_emu_load_state_preview(slot->file) ?: rg_surface_load_image_file(slot->preview, 0);
             if (slot->is_lastused)
                 snprintf(buffer, sizeof(buffer), "Slot %d (last used)", slot->id);
             else
@@ -1831,6 +2077,10 @@ void rg_gui_game_menu(void)
 
     rg_audio_set_mute(true);
 
+    // Background saves can't interrupt the game, their errors are reported here instead
+    if (rg_emu_save_failed())
+        rg_gui_alert(_("Save failed"), NULL);
+
     sel = rg_gui_dialog("Retro-Go", choices, 0);
 
     if (sel == 3000)
@@ -1845,7 +2095,7 @@ void rg_gui_game_menu(void)
 
     switch (sel)
     {
-        case 1000: if ((slot = rg_gui_savestate_menu(_("Save"), rom_path)) >= 0) rg_emu_save_state(slot); break;
+        case 1000: if ((slot = rg_gui_savestate_menu(_("Save"), rom_path)) >= 0) rg_emu_save_state_async(slot, NULL); break;
         case 2000: if ((slot = rg_gui_savestate_menu(_("Save"), rom_path)) >= 0 && rg_emu_save_state(slot)) rg_system_exit(); break;
         case 3001: if ((slot = rg_gui_savestate_menu(_("Load"), rom_path)) >= 0) rg_emu_load_state(slot); break;
         case 3002: rg_emu_reset(false); break;
@@ -122,7 +122,11 @@ void rg_gui_draw_dialog(const char *header, const rg_gui_option_t *options, int
 void rg_gui_draw_image(int x_pos, int y_pos, int width, int height, bool resample, const rg_image_t *img);
 void rg_gui_draw_hourglass(void); // This should be moved to system or display...
 void rg_gui_draw_status_bars(void);
-void rg_gui_draw_keyboard(const rg_keyboard_map_t *map, size_t cursor);
+void rg_gui_draw_keyboard(const rg_keyboard_map_t *map, size_t cursor); // NULL map closes the keyboard
+// The status overlay shows the speed line of the status bars on the OSD while the game runs
+void rg_gui_set_status_overlay(bool enable);
+bool rg_gui_get_status_overlay(void);
+void rg_gui_update_status_overlay(void);
 void rg_gui_draw_message(const char *format, ...);
 
 intptr_t rg_gui_dialog(const char *title, const rg_gui_option_t *options, int selected_index);
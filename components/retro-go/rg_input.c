@@ -43,6 +43,64 @@ static uint32_t gamepad_state = -1; // _Atomic
 static uint32_t gamepad_mapped = 0;
 static rg_battery_t battery_state = {0};
 
+#ifdef RG_ENABLE_BENCHMARK
+typedef struct
+{
+    int frame;
+    uint32_t state;
+} script_event_t;
+static script_event_t *input_script;
+static size_t input_script_length;
+
+static uint32_t parse_script_key(const char *token)
+{
+    if (token[0] >= '0' && token[0] <= '9')
+        return strtoul(token, NULL, 0);
+    if (strcasecmp(token, "L") == 0)
+        return RG_KEY_L;
+    if (strcasecmp(token, "R") == 0)
+        return RG_KEY_R;
+    if (strcasecmp(token, "None") == 0)
+        return RG_KEY_NONE;
+    for (int i = 0; i < RG_KEY_COUNT; ++i)
+    {
+        if (strcasecmp(token, rg_input_get_key_name(1 << i)) == 0)
+            return 1 << i;
+    }
+    RG_LOGW("Unknown key '%s' in input script", token);
+    return 0;
+}
+
+// Each line is `<frame> <key>[+<key>...]`, the state is held until the next line. Example:
+//   120 Start
+//   180 A+Right
+//   300 None
+static void load_input_script(const char *filename)
+{
+    char line[128];
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+    {
+        RG_LOGE("Unable to open input script '%s'", filename);
+        return;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        char *keys = line;
+        int frame = strtol(line, &keys, 10);
+        if (keys == line) // Blank line or comment
+            continue;
+        uint32_t state = 0;
+        for (char *token = strtok(keys, " \t\r\n+|"); token; token = strtok(NULL, " \t\r\n+|"))
+            state |= parse_script_key(token);
+        input_script = realloc(input_script, (input_script_length + 1) * sizeof(script_event_t));
+        input_script[input_script_length++] = (script_event_t){frame, state};
+    }
+    fclose(fp);
+    RG_LOGI("Loaded %d input events from '%s'", (int)input_script_length, filename);
+}
+#endif
+
 #define UPDATE_GLOBAL_MAP(keymap)                 \
     for (size_t i = 0; i < RG_COUNT(keymap); ++i) \
         gamepad_mapped |= keymap[i].key;          \
@@ -357,6 +415,12 @@ void rg_input_init(void)
     // The first read returns bogus data in some drivers, waste it.
     rg_input_read_gamepad_raw(NULL);
 
+#ifdef RG_ENABLE_BENCHMARK
+    const char *script = getenv("RG_BENCH_INPUT");
+    if (script && script[0])
+        load_input_script(script);
+#endif
+
     // Start background polling
     rg_task_create("rg_input", &input_task, NULL, 3 * 1024, RG_TASK_PRIORITY_6, 1);
     while (gamepad_state == -1)
@@ -376,6 +440,14 @@ uint32_t rg_input_read_gamepad(void)
 {
 #ifdef RG_TARGET_SDL2
     SDL_PumpEvents();
+#endif
+#ifdef RG_ENABLE_BENCHMARK
+    // Benchmark runs are headless, input comes exclusively from the script (keyed by tick)
+    int frame = rg_system_get_counters().ticks;
+    uint32_t state = 0;
+    for (size_t i = 0; i < input_script_length && input_script[i].frame <= frame; ++i)
+        state = input_script[i].state;
+    return state;
 #endif
     return gamepad_state;
 }
@@ -459,7 +531,10 @@ int rg_input_read_keyboard(const rg_keyboard_map_t *map)
         int prev_cursor = cursor;
 
         if (joystick & RG_KEY_A)
+        {
+            rg_gui_draw_keyboard(NULL, 0);
             return map->data[cursor];
+        }
         if (joystick & RG_KEY_B)
             break;
 
@@ -488,5 +563,6 @@ int rg_input_read_keyboard(const rg_keyboard_map_t *map)
         rg_system_tick(0);
     }
 
+    rg_gui_draw_keyboard(NULL, 0);
     return -1;
 }
@@ -17,6 +17,21 @@
 
 #ifdef ESP_PLATFORM
 #include <esp_vfs_fat.h>
+#include <esp_partition.h>
+#include <esp_heap_caps.h>
+#if ESP_IDF_VERSION_MAJOR < 5
+#include <soc/soc_memory_layout.h>
+#else
+#include <esp_memory_utils.h>
+#endif
+#endif
+
+#if RG_ZIP_SUPPORT
+#if defined(ESP_PLATFORM) && ESP_IDF_VERSION_MAJOR < 5
+#include <rom/miniz.h>
+#else
+#include <miniz.h>
+#endif
 #endif
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -30,6 +45,7 @@
 #else
 #include <dirent.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #endif
 
 static bool disk_mounted = false;
@@ -40,6 +56,29 @@ static sdmmc_card_t *card_handle = NULL;
 static wl_handle_t wl_handle = WL_INVALID_HANDLE;
 #endif
 
+#define SRAM_MAX_OPEN 4
+static rg_sram_t *sram_list[SRAM_MAX_OPEN];
+static rg_mutex_t *sram_lock;
+static int sram_autosave = RG_SRAM_AUTOSAVE_DELAY;
+static volatile bool sram_snapshot_due;
+
+typedef struct io_request_s
+{
+    rg_storage_job_t *job;
+    rg_storage_cb_t *callback;
+    void *arg;
+    void *tag;
+    int priority;
+    struct io_request_s *next;
+} io_request_t;
+static io_request_t *io_queue; // Sorted by priority, in submission order within a priority
+static rg_mutex_t *io_lock;
+static rg_task_t *io_task;
+static volatile int io_pending;
+
+static bool sram_flush(rg_sram_t *sram);
+static void sram_autosave_tick(void);
+
 #define CHECK_PATH(path)          \
     if (!(path && path[0]))       \
     {                             \
@@ -68,6 +107,11 @@ void rg_storage_init(void)
     RG_ASSERT(!disk_mounted, "Storage already initialized!");
     int error_code = -1;
 
+    if (!sram_lock)
+        sram_lock = rg_mutex_create();
+    if (!io_lock)
+        io_lock = rg_mutex_create();
+
 #if defined(RG_STORAGE_SDSPI_HOST)
 
     RG_LOGI("Looking for SD Card using SDSPI...");
@@ -195,7 +239,22 @@ void rg_storage_deinit(void)
     if (!disk_mounted)
         return;
 
+    // Queued writes and whatever battery-backed RAM is still dirty must reach the disk before we unmount
+    rg_storage_wait_idle();
+    if (sram_lock)
+    {
+        rg_mutex_take(sram_lock, -1);
+        for (int i = 0; i < SRAM_MAX_OPEN; ++i)
+        {
+            if (sram_list[i])
+                sram_flush(sram_list[i]);
+        }
+        sram_autosave = 0;
+        rg_mutex_give(sram_lock);
+    }
+
     rg_storage_commit();
+    rg_storage_unmap_rom();
 
     int error_code = 0;
 
@@ -425,6 +484,45 @@ int64_t rg_storage_get_free_space(const char *path)
     return -1;
 }
 
+/**
+ * Bulk transfers bypass stdio's buffer and reach the filesystem in large chunks that start on a sector
+ * boundary, so FatFs can move whole clusters at once. The SD drivers need DMA-capable memory, on ESP32
+ * chunks to or from PSRAM are bounced through an internal buffer instead of one sector at a time.
+ */
+static bool storage_transfer(FILE *fp, void *buffer, size_t length, bool write)
+{
+    const size_t chunk_size = RG_STORAGE_IO_CHUNK_SIZE;
+    uint8_t *bounce = NULL;
+    bool success = true;
+
+#ifdef ESP_PLATFORM
+    if (length > 512 && !esp_ptr_dma_capable(buffer))
+        bounce = heap_caps_malloc(RG_MIN(chunk_size, length), MALLOC_CAP_DMA);
+#endif
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    for (size_t pos = 0; pos < length && success; pos += chunk_size)
+    {
+        size_t chunk = RG_MIN(chunk_size, length - pos);
+        uint8_t *ptr = (uint8_t *)buffer + pos;
+        if (write)
+        {
+            if (bounce)
+                memcpy(bounce, ptr, chunk);
+            success = fwrite(bounce ? bounce : ptr, chunk, 1, fp) == 1;
+        }
+        else
+        {
+            success = fread(bounce ? bounce : ptr, chunk, 1, fp) == 1;
+            if (success && bounce)
+                memcpy(ptr, bounce, chunk);
+        }
+    }
+
+    free(bounce);
+    return success;
+}
+
 bool rg_storage_read_file(const char *path, void **data_out, size_t *data_len, uint32_t flags)
 {
     RG_ASSERT_ARG(data_out && data_len);
@@ -433,9 +531,11 @@ bool rg_storage_read_file(const char *path, void **data_out, size_t *data_len, u
     size_t output_buffer_alloc_size;
     size_t output_buffer_size;
     void *output_buffer;
-    size_t file_size;
+    struct stat statbuf;
 
     FILE *fp = fopen(path, "rb");
+    if (!fp && errno == ENOENT && rg_storage_restore_backup(path))
+        fp = fopen(path, "rb");
     if (!fp)
     {
         if (errno != ENOENT) // Only log unusual errors. Path not found isn't unusual.
@@ -443,21 +543,24 @@ bool rg_storage_read_file(const char *path, void **data_out, size_t *data_len, u
         return false;
     }
 
-    fseek(fp, 0, SEEK_END);
-    file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    if (fstat(fileno(fp), &statbuf) != 0)
+    {
+        RG_LOGE("Fstat failed (%d): '%s'", errno, path);
+        fclose(fp);
+        return false;
+    }
 
     if (flags & RG_FILE_USER_BUFFER)
     {
         output_buffer_alloc_size = *data_len;
-        output_buffer_size = RG_MIN(*data_len, file_size);
+        output_buffer_size = RG_MIN(*data_len, statbuf.st_size);
         output_buffer = *data_out;
     }
     else
     {
         size_t blocksize = RG_MAX(0x400, (flags & 0xF) * 0x2000);
-        output_buffer_alloc_size = (file_size + (blocksize - 1)) & ~(blocksize - 1);
-        output_buffer_size = file_size;
+        output_buffer_alloc_size = (statbuf.st_size + (blocksize - 1)) & ~(blocksize - 1);
+        output_buffer_size = statbuf.st_size;
         output_buffer = malloc(output_buffer_alloc_size);
     }
 
@@ -468,7 +571,7 @@ bool rg_storage_read_file(const char *path, void **data_out, size_t *data_len, u
         return false;
     }
 
-    if (!fread(output_buffer, output_buffer_size, 1, fp))
+    if (!storage_transfer(fp, output_buffer, output_buffer_size, false))
     {
         RG_LOGE("File read failed (%d): '%s'", errno, path);
         fclose(fp);
@@ -495,170 +598,1589 @@ bool rg_storage_write_file(const char *path, const void *data_ptr, size_t data_l
     RG_ASSERT_ARG(data_ptr || !data_len);
     CHECK_PATH(path);
 
-    // TODO: If atomic is true we should write to a temp file and only replace the target on success
-    FILE *fp = fopen(path, "wb");
+    char temp_path[RG_PATH_MAX + 8];
+    const char *write_path = path;
+
+    if (flags & RG_FILE_ATOMIC_WRITE)
+    {
+        snprintf(temp_path, sizeof(temp_path), "%s.new", path);
+        write_path = temp_path;
+    }
+
+    FILE *fp = fopen(write_path, "wb");
     if (!fp)
     {
-        RG_LOGE("Fopen failed (%d): '%s'", errno, path);
+        RG_LOGE("Fopen failed (%d): '%s'", errno, write_path);
         return false;
     }
 
-    if (data_len && !fwrite(data_ptr, data_len, 1, fp))
+    bool success = storage_transfer(fp, (void *)data_ptr, data_len, true);
+    success = fclose(fp) == 0 && success;
+
+    if (!success)
     {
-        RG_LOGE("Fwrite failed (%d): '%s'", errno, path);
-        fclose(fp);
+        RG_LOGE("Fwrite failed (%d): '%s'", errno, write_path);
+        if (write_path != path)
+            remove(write_path);
         return false;
     }
 
-    fclose(fp);
+    if (write_path != path)
+        return rg_storage_replace(write_path, path);
+
     return true;
 }
 
-/**
- * This is a minimal UNZIP implementation that utilizes only the miniz primitives found in ESP32's ROM.
- * I think that we should use miniz' ZIP API instead and bundle miniz with retro-go. But first I need
- * to do some testing to determine if the increased executable size is acceptable...
- */
-#if RG_ZIP_SUPPORT
+bool rg_storage_restore_backup(const char *path)
+{
+    CHECK_PATH(path);
+#if defined(ESP_PLATFORM) || defined(_WIN32) || defined(_WIN64)
+    char backup[RG_PATH_MAX + 8];
+    snprintf(backup, sizeof(backup), "%s.bak", path);
+    if (access(path, F_OK) != 0 && access(backup, F_OK) == 0)
+    {
+        RG_LOGW("Restoring '%s' from its backup", path);
+        return rename(backup, path) == 0;
+    }
+#endif
+    return false;
+}
 
-#if defined(ESP_PLATFORM) && ESP_IDF_VERSION_MAJOR < 5
-#include <rom/miniz.h>
+bool rg_storage_replace(const char *source, const char *target)
+{
+    CHECK_PATH(source);
+    CHECK_PATH(target);
+
+#if defined(ESP_PLATFORM) || defined(_WIN32) || defined(_WIN64)
+    // rename() refuses to overwrite here, the old file is moved aside then restored if anything fails
+    char backup[RG_PATH_MAX + 8];
+    snprintf(backup, sizeof(backup), "%s.bak", target);
+    remove(backup);
+    bool have_backup = rename(target, backup) == 0;
+    if (rename(source, target) != 0)
+    {
+        RG_LOGE("Rename failed (%d): '%s'", errno, source);
+        if (have_backup)
+            rename(backup, target);
+        return false;
+    }
+    if (have_backup)
+        remove(backup);
 #else
-#include <miniz.h>
+    if (rename(source, target) != 0)
+    {
+        RG_LOGE("Rename failed (%d): '%s'", errno, source);
+        return false;
+    }
 #endif
+    return true;
+}
 
-#define ZIP_MAGIC 0x04034b50
-typedef struct __attribute__((packed))
+/**
+ * Storage task. Requests are kept in a list sorted by priority, the task's message queue is only used
+ * to wake it up. Battery-backed RAM is checked every second ahead of any request (see sram_autosave_tick).
+ */
+static void io_task_func(void *arg)
 {
-    uint32_t magic;
-    uint16_t version;
-    uint16_t flags;
-    uint16_t compression;
-    uint16_t modified_time;
-    uint16_t modified_date;
-    uint32_t checksum;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-    uint16_t filename_size;
-    uint16_t extra_field_size;
-    uint8_t filename[226];
-    // uint8_t extra_field[];
-    // uint8_t compressed_data[];
-} zip_header_t;
+    int64_t next_sram_tick = 0;
+    rg_task_msg_t msg;
 
-bool rg_storage_unzip_file(const char *zip_path, const char *filter, void **data_out, size_t *data_len, uint32_t flags)
+    while (true)
+    {
+        if (rg_system_timer() >= next_sram_tick)
+        {
+            sram_autosave_tick();
+            next_sram_tick = rg_system_timer() + 1000000;
+        }
+
+        rg_mutex_take(io_lock, -1);
+        io_request_t *req = io_queue;
+        if (req)
+            io_queue = req->next;
+        rg_mutex_give(io_lock);
+
+        if (!req)
+        {
+            rg_task_receive(&msg, 1000);
+            continue;
+        }
+
+        bool success = req->job(req->arg);
+        if (req->callback)
+            req->callback(req->arg, success);
+        free(req);
+        __atomic_sub_fetch(&io_pending, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+static bool io_start(void)
 {
-    RG_ASSERT_ARG(data_out && data_len);
-    CHECK_PATH(zip_path);
+    if (!io_task)
+        io_task = rg_task_create("rg_storage", &io_task_func, NULL, 6 * 1024, RG_TASK_PRIORITY_1, -1);
+    return io_task != NULL;
+}
+
+static bool io_submit(rg_storage_job_t *job, rg_storage_cb_t *callback, void *arg, void *tag, int priority)
+{
+    io_request_t *req = calloc(1, sizeof(io_request_t));
+    if (!req || !io_start())
+    {
+        RG_LOGE("Unable to queue request!");
+        free(req);
+        return false;
+    }
+    *req = (io_request_t){job, callback, arg, tag, priority, NULL};
+
+    rg_mutex_take(io_lock, -1);
+    io_request_t **pos = &io_queue;
+    while (*pos && (*pos)->priority >= priority)
+        pos = &(*pos)->next;
+    req->next = *pos;
+    *pos = req;
+    __atomic_add_fetch(&io_pending, 1, __ATOMIC_ACQ_REL);
+    rg_mutex_give(io_lock);
+
+    // If the queue is full the task has wake ups pending already
+    rg_task_send(io_task, &(rg_task_msg_t){0}, 0);
+    return true;
+}
 
-    zip_header_t header = {0};
-    int header_pos = 0;
+bool rg_storage_queue(rg_storage_job_t *job, rg_storage_cb_t *callback, void *arg, int priority)
+{
+    RG_ASSERT_ARG(job);
+    return io_submit(job, callback, arg, arg, priority);
+}
 
-    FILE *fp = fopen(zip_path, "rb");
-    if (!fp)
+void rg_storage_cancel(void *arg)
+{
+    io_request_t *cancelled = NULL;
+
+    rg_mutex_take(io_lock, -1);
+    for (io_request_t **pos = &io_queue; *pos;)
     {
-        if (errno != ENOENT) // Only log unusual errors. Path not found isn't unusual.
-            RG_LOGE("Fopen failed (%d): '%s'", errno, zip_path);
+        io_request_t *req = *pos;
+        if (req->tag == arg)
+        {
+            *pos = req->next;
+            req->next = cancelled;
+            cancelled = req;
+        }
+        else
+            pos = &req->next;
+    }
+    rg_mutex_give(io_lock);
+
+    while (cancelled)
+    {
+        io_request_t *req = cancelled;
+        cancelled = req->next;
+        if (req->callback)
+            req->callback(req->arg, false);
+        free(req);
+        __atomic_sub_fetch(&io_pending, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+void rg_storage_wait_idle(void)
+{
+    if (io_task && rg_task_current() == io_task)
+        return; // A request waiting on the queue would never return
+    while (io_pending > 0)
+        rg_task_delay(10);
+}
+
+typedef struct
+{
+    char *path;
+    void *data;
+    size_t data_len;
+    uint32_t flags;
+    rg_storage_read_cb_t *read_callback;
+    rg_storage_cb_t *write_callback;
+    void *arg;
+} io_file_job_t;
+
+static bool io_read_job(void *arg)
+{
+    io_file_job_t *job = arg;
+    return rg_storage_read_file(job->path, &job->data, &job->data_len, job->flags);
+}
+
+static void io_read_done(void *arg, bool success)
+{
+    io_file_job_t *job = arg;
+    if (job->read_callback)
+        job->read_callback(job->arg, job->path, success ? job->data : NULL, success ? job->data_len : 0);
+    else if (success)
+        free(job->data);
+    free(job->path);
+    free(job);
+}
+
+static bool io_write_job(void *arg)
+{
+    io_file_job_t *job = arg;
+    return rg_storage_write_file(job->path, job->data, job->data_len, job->flags);
+}
+
+static void io_write_done(void *arg, bool success)
+{
+    io_file_job_t *job = arg;
+    if (!success)
+        RG_LOGE("Background write failed: '%s'", job->path);
+    if (job->write_callback)
+        job->write_callback(job->arg, success);
+    free(job->data);
+    free(job->path);
+    free(job);
+}
+
+bool rg_storage_read_file_async(const char *path, uint32_t flags, int priority, rg_storage_read_cb_t *callback, void *arg)
+{
+    CHECK_PATH(path);
+    RG_ASSERT_ARG(!(flags & RG_FILE_USER_BUFFER));
+
+    io_file_job_t *job = calloc(1, sizeof(io_file_job_t));
+    if (!job || !(job->path = strdup(path)))
+    {
+        free(job);
         return false;
     }
+    job->flags = flags;
+    job->read_callback = callback;
+    job->arg = arg;
 
-    // Very inefficient, we should read a block at a time and search it for a header. But I'm lazy.
-    // Thankfully the header is usually found on the very first read :)
-    for (header_pos = 0; !feof(fp) && header_pos < 0x10000; ++header_pos)
+    if (!io_submit(io_read_job, io_read_done, job, arg, priority))
     {
-        fseek(fp, header_pos, SEEK_SET);
-        fread(&header, sizeof(header), 1, fp);
-        if (header.magic == ZIP_MAGIC)
-            break;
+        free(job->path);
+        free(job);
+        return false;
     }
+    return true;
+}
+
+bool rg_storage_write_file_async(const char *path, void *data, size_t data_len, uint32_t flags, int priority, rg_storage_cb_t *callback, void *arg)
+{
+    CHECK_PATH(path);
+    RG_ASSERT_ARG(data || !data_len);
 
-    if (header.magic != ZIP_MAGIC)
+    io_file_job_t *job = calloc(1, sizeof(io_file_job_t));
+    if (!job || !(job->path = strdup(path)))
     {
-        RG_LOGE("No valid header found: '%s'", zip_path);
-        fclose(fp);
+        free(job);
         return false;
     }
+    job->data = data;
+    job->data_len = data_len;
+    job->flags = flags;
+    job->write_callback = callback;
+    job->arg = arg;
 
-    // Zero terminate or truncate filename just in case
-    header.filename[RG_MIN(header.filename_size, 225)] = 0;
+    if (!io_submit(io_write_job, io_write_done, job, arg, priority))
+    {
+        free(job->path);
+        free(job);
+        return false;
+    }
+    return true;
+}
 
-    RG_LOGI("Found file at %d, name: '%s', size: %d", header_pos, header.filename, (int)header.uncompressed_size);
+FILE *rg_storage_memopen(void *buffer, size_t size, const char *mode)
+{
+    RG_ASSERT_ARG(buffer && size && mode);
+#if defined(_WIN32) || defined(_WIN64)
+    RG_LOGW("fmemopen isn't available on this platform!");
+    return NULL;
+#else
+    FILE *fp = fmemopen(buffer, size, mode);
+    if (!fp)
+        RG_LOGE("fmemopen failed (%d)", errno);
+    return fp;
+#endif
+}
 
-    size_t stream_offset = header_pos + 30 + header.filename_size + header.extra_field_size;
-    size_t stream_remaining = header.compressed_size;
-    size_t output_buffer_align = RG_MAX(0x1000, (flags & 0xF) * 0x2000);
-    size_t output_buffer_size;
-    size_t output_buffer_pos = 0;
-    uint8_t *output_buffer = NULL;
 
-    if (flags & RG_FILE_USER_BUFFER)
+static void sram_update_checksums(rg_sram_t *sram)
+{
+    if (!(sram->flags & RG_SRAM_AUTODETECT))
+        return;
+    size_t page_size = 1 << sram->page_shift;
+    for (size_t i = 0; i * page_size < sram->size; ++i)
     {
-        output_buffer_size = RG_MIN(*data_len, header.uncompressed_size);
-        output_buffer = *data_out;
+        uint32_t checksum = rg_crc32(0, sram->data + i * page_size, RG_MIN(page_size, sram->size - i * page_size));
+        if (checksum != sram->checksums[i])
+            sram->dirty |= 1u << i;
+        sram->checksums[i] = checksum;
     }
-    else
+}
+
+// Same as sram_update_checksums but it doesn't touch the tracker, so it's safe to call from another
+// task while the emulator runs. A torn read only means that the page will be copied and checked again.
+static bool sram_has_changed(rg_sram_t *sram)
+{
+    if (sram->dirty || sram->snapshot_pages)
+        return true;
+    if (!(sram->flags & RG_SRAM_AUTODETECT))
+        return false;
+    size_t page_size = 1 << sram->page_shift;
+    for (size_t i = 0; i * page_size < sram->size; ++i)
     {
-        output_buffer_size = header.uncompressed_size;
-        output_buffer = malloc((output_buffer_size + (output_buffer_align - 1)) & ~(output_buffer_align - 1));
+        if (rg_crc32(0, sram->data + i * page_size, RG_MIN(page_size, sram->size - i * page_size)) != sram->checksums[i])
+            return true;
     }
+    return false;
+}
 
-    size_t read_buffer_size = 0x8000;
-    uint8_t *read_buffer = malloc(read_buffer_size);
-    tinfl_decompressor *decomp = malloc(sizeof(tinfl_decompressor));
+// Copies the dirty pages, this must be done by the emulator's thread between frames so that the file
+// never gets a page in the middle of being updated (eg: a save state restoring PRG-RAM)
+static void sram_snapshot(rg_sram_t *sram)
+{
+    sram_update_checksums(sram);
+
+    uint32_t dirty = __atomic_exchange_n(&sram->dirty, 0, __ATOMIC_ACQ_REL);
+    size_t page_size = 1 << sram->page_shift;
 
-    if (!read_buffer || !output_buffer || !decomp)
+    if (dirty && !sram->complete)
+        dirty = 0xFFFFFFFF;
+
+    for (size_t i = 0; i * page_size < sram->size; ++i)
     {
-        RG_LOGE("Memory allocation failed: '%s'", zip_path);
-        goto _fail;
+        if (dirty & (1u << i))
+            memcpy(sram->snapshot + i * page_size, sram->data + i * page_size, RG_MIN(page_size, sram->size - i * page_size));
+    }
+
+    sram->snapshot_pages |= dirty;
+    sram->snapshot_due = false;
+}
+
+// Writes the pages held in the snapshot, sram_lock must be held
+static bool sram_write(rg_sram_t *sram)
+{
+    uint32_t dirty = sram->snapshot_pages;
+    size_t page_size = 1 << sram->page_shift;
+    int pages = 0;
+
+    if (!dirty)
+        return true;
+
+    FILE *fp = fopen(sram->path, sram->complete ? "r+b" : "wb");
+    bool success = fp != NULL;
+
+    for (size_t i = 0; success && i * page_size < sram->size; ++i)
+    {
+        if (!(dirty & (1u << i)))
+            continue;
+        size_t len = RG_MIN(page_size, sram->size - i * page_size);
+        success = fseek(fp, i * page_size, SEEK_SET) == 0 && fwrite(sram->snapshot + i * page_size, len, 1, fp) == 1;
+        pages++;
+    }
+
+    if (success && sram->write_extra)
+        success = fseek(fp, sram->size, SEEK_SET) == 0 && sram->write_extra(fp);
+
+    if (fp && fclose(fp) != 0)
+        success = false;
+
+    if (!success)
+    {
+        // The snapshot is kept, the next tick will try again
+        RG_LOGE("SRAM write failed (%d): '%s'", errno, sram->path);
+        return false;
     }
 
-    tinfl_status status;
-    tinfl_init(decomp);
+    RG_LOGI("Saved %d SRAM page(s) to '%s'", pages, sram->path);
+    sram->snapshot_pages = 0;
+    sram->complete = true;
+    sram->dirty_since = 0;
+    rg_storage_commit();
+    return true;
+}
+
+// Snapshot and write right away, sram_lock must be held and we must be on the emulator's thread
+static bool sram_flush(rg_sram_t *sram)
+{
+    sram_snapshot(sram);
+    return sram_write(sram);
+}
+
+// Called by the storage task every second, before it picks the next request
+static void sram_autosave_tick(void)
+{
+    rg_mutex_take(sram_lock, -1);
+    for (int i = 0; i < SRAM_MAX_OPEN; ++i)
+    {
+        rg_sram_t *sram = sram_list[i];
+        if (!sram || sram_autosave <= 0)
+            continue;
+        if (sram->snapshot_pages)
+            sram_write(sram);
+        else if (!sram_has_changed(sram))
+            sram->dirty_since = 0;
+        else if (!sram->dirty_since)
+            sram->dirty_since = rg_system_timer();
+        else if (rg_system_timer() - sram->dirty_since >= sram_autosave * 1000000LL)
+            sram->snapshot_due = sram_snapshot_due = true;
+    }
+    rg_mutex_give(sram_lock);
+}
+
+void rg_sram_tick(void)
+{
+    // Never wait for the storage task, if it's busy writing we'll try again on the next frame
+    if (!sram_snapshot_due || !rg_mutex_take(sram_lock, 0))
+        return;
+    for (int i = 0; i < SRAM_MAX_OPEN; ++i)
+    {
+        if (sram_list[i] && sram_list[i]->snapshot_due)
+            sram_snapshot(sram_list[i]);
+    }
+    sram_snapshot_due = false;
+    rg_mutex_give(sram_lock);
+}
 
-    do
+rg_sram_t *rg_sram_open(const char *path, void *data, size_t size, uint32_t flags)
+{
+    RG_ASSERT_ARG(path && data && size);
+
+    rg_sram_t *sram = calloc(1, sizeof(rg_sram_t));
+    RG_ASSERT(sram, "Out of memory");
+    sram->path = strdup(path);
+    sram->data = data;
+    sram->size = size;
+    sram->flags = flags;
+    // Pages are at least a sector and the bitmap is 32 bits
+    sram->page_shift = 9;
+    while (((size - 1) >> sram->page_shift) >= 32)
+        sram->page_shift++;
+    if (flags & RG_SRAM_AUTODETECT)
+        sram->checksums = calloc(32, sizeof(uint32_t));
+    sram->snapshot = malloc(size);
+    RG_ASSERT(sram->snapshot, "Out of memory");
+
+    rg_storage_mkdir(rg_dirname(path));
+    rg_sram_load(sram);
+
+    io_start();
+
+    rg_mutex_take(sram_lock, -1);
+    for (int i = 0; i < SRAM_MAX_OPEN; ++i)
     {
-        size_t input_size = RG_MIN(read_buffer_size, stream_remaining);
-        size_t output_size = output_buffer_size - output_buffer_pos;
-        if (fseek(fp, stream_offset, SEEK_SET) != 0 || fread(read_buffer, input_size, 1, fp) != 1)
+        if (!sram_list[i])
         {
-            RG_LOGE("Read error (%d): '%s'", errno, zip_path);
-            goto _fail;
+            sram_list[i] = sram;
+            break;
         }
-        stream_offset += input_size;
-        stream_remaining -= input_size;
-        status = tinfl_decompress(
-            decomp, read_buffer, &input_size, output_buffer, output_buffer + output_buffer_pos, &output_size,
-            TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | (stream_remaining ? TINFL_FLAG_HAS_MORE_INPUT : 0));
-        output_buffer_pos += output_size;
-    } while (status == TINFL_STATUS_NEEDS_MORE_INPUT);
-
-    // With user-provided buffer we might not reach TINFL_STATUS_DONE, but it doesn't mean we've failed
-    if (status < TINFL_STATUS_DONE || output_buffer_pos != output_buffer_size) // (status != TINFL_STATUS_DONE)
-    {
-        RG_LOGE("Decompression failed (%d): %s", (int)status, zip_path);
-        goto _fail;
     }
+    rg_mutex_give(sram_lock);
 
-    free(read_buffer);
-    free(decomp);
-    fclose(fp);
+    return sram;
+}
 
-    *data_out = output_buffer;
-    *data_len = output_buffer_size;
-    return true;
+bool rg_sram_load(rg_sram_t *sram)
+{
+    RG_ASSERT_ARG(sram);
 
-_fail:
-    if (!(flags & RG_FILE_USER_BUFFER))
-        free(output_buffer);
-    free(read_buffer);
-    free(decomp);
-    fclose(fp);
-    return false;
+    if (sram_lock)
+        rg_mutex_take(sram_lock, -1);
+
+    FILE *fp = fopen(sram->path, "rb");
+    size_t len = fp ? fread(sram->data, 1, sram->size, fp) : 0;
+    if (fp)
+        fclose(fp);
+
+    RG_LOGI("Loaded %d bytes of SRAM from '%s'", (int)len, sram->path);
+    sram->complete = len == sram->size;
+    sram_update_checksums(sram);
+    sram->dirty = 0;
+    sram->dirty_since = 0;
+    sram->snapshot_pages = 0;
+    sram->snapshot_due = false;
+
+    if (sram_lock)
+        rg_mutex_give(sram_lock);
+
+    return len > 0;
 }
-#else
-bool rg_storage_unzip_file(const char *zip_path, const char *filter, void **data_out, size_t *data_len, uint32_t flags)
+
+bool rg_sram_flush(rg_sram_t *sram)
 {
-    RG_LOGE("ZIP support hasn't been enabled!");
-    return false;
+    RG_ASSERT_ARG(sram);
+    rg_mutex_take(sram_lock, -1);
+    bool success = sram_flush(sram);
+    rg_mutex_give(sram_lock);
+    return success;
 }
+
+bool rg_sram_is_dirty(rg_sram_t *sram)
+{
+    RG_ASSERT_ARG(sram);
+    rg_mutex_take(sram_lock, -1);
+    sram_update_checksums(sram);
+    bool dirty = sram->dirty || sram->snapshot_pages;
+    rg_mutex_give(sram_lock);
+    return dirty;
+}
+
+void rg_sram_close(rg_sram_t *sram)
+{
+    if (!sram)
+        return;
+    rg_mutex_take(sram_lock, -1);
+    sram_flush(sram);
+    for (int i = 0; i < SRAM_MAX_OPEN; ++i)
+    {
+        if (sram_list[i] == sram)
+            sram_list[i] = NULL;
+    }
+    rg_mutex_give(sram_lock);
+    free(sram->snapshot);
+    free(sram->checksums);
+    free(sram->path);
+    free(sram);
+}
+
+void rg_sram_set_autosave(int seconds)
+{
+    sram_autosave = RG_MAX(seconds, 0);
+}
+
+/**
+ * This is a minimal UNZIP implementation that utilizes only the miniz primitives found in ESP32's ROM.
+ * The entry is located through the central directory, then its data is read in a single sequential pass.
+ */
+#if RG_ZIP_SUPPORT
+
+#define ZIP_LOCAL_MAGIC 0x04034b50
+#define ZIP_CENTRAL_MAGIC 0x02014b50
+#define ZIP_EOCD_MAGIC 0x06054b50
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint16_t compression;
+    uint16_t modified_time;
+    uint16_t modified_date;
+    uint32_t checksum;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint16_t filename_size;
+    uint16_t extra_field_size;
+    // uint8_t filename[];
+    // uint8_t extra_field[];
+    // uint8_t compressed_data[];
+} zip_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version_made_by;
+    uint16_t version;
+    uint16_t flags;
+    uint16_t compression;
+    uint16_t modified_time;
+    uint16_t modified_date;
+    uint32_t checksum;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint16_t filename_size;
+    uint16_t extra_field_size;
+    uint16_t comment_size;
+    uint16_t disk_number;
+    uint16_t internal_attributes;
+    uint32_t external_attributes;
+    uint32_t header_offset;
+    // uint8_t filename[];
+    // uint8_t extra_field[];
+    // uint8_t comment[];
+} zip_central_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t disk_number;
+    uint16_t central_disk_number;
+    uint16_t disk_entries;
+    uint16_t total_entries;
+    uint32_t central_size;
+    uint32_t central_offset;
+    uint16_t comment_size;
+} zip_eocd_t;
+
+typedef struct
+{
+    char name[128];
+    uint16_t compression;
+    uint32_t checksum;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint32_t data_offset;
+} zip_entry_t;
+
+static bool zip_find_eocd(FILE *fp, zip_eocd_t *eocd)
+{
+    if (fseek(fp, 0, SEEK_END) != 0)
+        return false;
+
+    long file_size = ftell(fp);
+    if (file_size < (long)sizeof(zip_eocd_t))
+        return false;
+
+    // The record is normally the last thing in the file, unless the archive has a comment
+    if (fseek(fp, -(long)sizeof(zip_eocd_t), SEEK_END) == 0 && fread(eocd, sizeof(zip_eocd_t), 1, fp) == 1
+        && eocd->magic == ZIP_EOCD_MAGIC && eocd->comment_size == 0)
+        return true;
+
+    size_t tail_size = RG_MIN(file_size, (long)sizeof(zip_eocd_t) + 0xFFFF);
+    uint8_t *tail = malloc(tail_size);
+    bool found = false;
+
+    if (tail && fseek(fp, file_size - tail_size, SEEK_SET) == 0 && fread(tail, tail_size, 1, fp) == 1)
+    {
+        for (long pos = tail_size - sizeof(zip_eocd_t); pos >= 0 && !found; --pos)
+        {
+            memcpy(eocd, tail + pos, sizeof(zip_eocd_t));
+            found = eocd->magic == ZIP_EOCD_MAGIC && pos + sizeof(zip_eocd_t) + eocd->comment_size == tail_size;
+        }
+    }
+    free(tail);
+    return found;
+}
+
+// Finds the first file matching filter (a list of extensions, see rg_extension_match), or the first
+// file if filter is NULL or nothing matches. On success fp is positioned at the start of its data.
+static bool zip_find_entry(FILE *fp, const char *filter, zip_entry_t *entry)
+{
+    zip_central_header_t header;
+    zip_eocd_t eocd;
+
+    if (!zip_find_eocd(fp, &eocd))
+    {
+        RG_LOGE("Central directory not found!");
+        return false;
+    }
+
+    // One extra byte so that the last name can be terminated in place
+    uint8_t *central = malloc(eocd.central_size + 1);
+    if (!central)
+    {
+        RG_LOGE("Memory allocation failed (%d bytes)", (int)eocd.central_size);
+        return false;
+    }
+
+    if (fseek(fp, eocd.central_offset, SEEK_SET) != 0 || fread(central, eocd.central_size, 1, fp) != 1)
+    {
+        RG_LOGE("Central directory read error (%d)", errno);
+        free(central);
+        return false;
+    }
+
+    bool found = false, matched = false;
+
+    for (size_t pos = 0; pos + sizeof(header) <= eocd.central_size && !matched;)
+    {
+        memcpy(&header, central + pos, sizeof(header));
+        if (header.magic != ZIP_CENTRAL_MAGIC)
+            break;
+
+        char *name = (char *)central + pos + sizeof(header);
+        size_t name_len = header.filename_size;
+        if (pos + sizeof(header) + name_len > eocd.central_size)
+            break;
+        pos += sizeof(header) + header.filename_size + header.extra_field_size + header.comment_size;
+
+        // The full name is matched, only the copy in entry->name is truncated
+        char next = name[name_len];
+        name[name_len] = 0;
+
+        // Skip directories and macOS' resource forks
+        bool skip = name_len == 0 || name[name_len - 1] == '/' || strncmp(name, "__MACOSX/", 9) == 0;
+
+        matched = !skip && filter && rg_extension_match(name, filter);
+        if (!skip && (!found || matched))
+        {
+            snprintf(entry->name, sizeof(entry->name), "%s", name);
+            entry->compression = header.compression;
+            entry->checksum = header.checksum;
+            entry->compressed_size = header.compressed_size;
+            entry->uncompressed_size = header.uncompressed_size;
+            entry->data_offset = header.header_offset;
+            found = true;
+        }
+        name[name_len] = next;
+    }
+    free(central);
+
+    if (!found)
+    {
+        RG_LOGE("No file found in archive!");
+        return false;
+    }
+
+    if (filter && !matched)
+        RG_LOGW("No file matching '%s', using '%s'", filter, entry->name);
+
+    // The local header's extra field can differ from the central one, the sizes however can be zero
+    // in the local header (when a data descriptor is used) so we keep those from the central directory.
+    zip_header_t local;
+    if (fseek(fp, entry->data_offset, SEEK_SET) != 0 || fread(&local, sizeof(local), 1, fp) != 1
+        || local.magic != ZIP_LOCAL_MAGIC)
+    {
+        RG_LOGE("Invalid local header at %d", (int)entry->data_offset);
+        return false;
+    }
+    entry->data_offset += sizeof(local) + local.filename_size + local.extra_field_size;
+
+    return fseek(fp, entry->data_offset, SEEK_SET) == 0;
+}
+
+bool rg_storage_unzip_file(const char *zip_path, const char *filter, void **data_out, size_t *data_len, uint32_t flags)
+{
+    RG_ASSERT_ARG(data_out && data_len);
+    CHECK_PATH(zip_path);
+
+    zip_entry_t entry = {0};
+
+    FILE *fp = fopen(zip_path, "rb");
+    if (!fp)
+    {
+        if (errno != ENOENT) // Only log unusual errors. Path not found isn't unusual.
+            RG_LOGE("Fopen failed (%d): '%s'", errno, zip_path);
+        return false;
+    }
+
+    if (!zip_find_entry(fp, filter, &entry))
+    {
+        RG_LOGE("No valid entry found: '%s'", zip_path);
+        fclose(fp);
+        return false;
+    }
+
+    RG_LOGI("Found file at %d, name: '%s', size: %d", (int)entry.data_offset, entry.name, (int)entry.uncompressed_size);
+
+    if (entry.compression != 0 && entry.compression != MZ_DEFLATED)
+    {
+        RG_LOGE("Unsupported compression method %d: '%s'", entry.compression, zip_path);
+        fclose(fp);
+        return false;
+    }
+
+    size_t stream_remaining = entry.compressed_size;
+    size_t output_buffer_align = RG_MAX(0x1000, (flags & 0xF) * 0x2000);
+    size_t output_buffer_size;
+    size_t output_buffer_pos = 0;
+    uint8_t *output_buffer = NULL;
+    size_t read_buffer_size = 0x8000;
+    uint8_t *read_buffer = NULL;
+    tinfl_decompressor *decomp = NULL;
+
+    if (flags & RG_FILE_USER_BUFFER)
+    {
+        output_buffer_size = RG_MIN(*data_len, entry.uncompressed_size);
+        output_buffer = *data_out;
+    }
+    else
+    {
+        output_buffer_size = entry.uncompressed_size;
+        output_buffer = malloc((output_buffer_size + (output_buffer_align - 1)) & ~(output_buffer_align - 1));
+    }
+
+    if (!output_buffer)
+    {
+        RG_LOGE("Memory allocation failed: '%s'", zip_path);
+        goto _fail;
+    }
+
+    if (entry.compression == 0)
+    {
+        // Stored, the data can go straight to the output buffer
+        if (fread(output_buffer, output_buffer_size, 1, fp) != 1)
+        {
+            RG_LOGE("Read error (%d): '%s'", errno, zip_path);
+            goto _fail;
+        }
+        output_buffer_pos = output_buffer_size;
+    }
+    else
+    {
+        read_buffer = malloc(read_buffer_size);
+        decomp = malloc(sizeof(tinfl_decompressor));
+        if (!read_buffer || !decomp)
+        {
+            RG_LOGE("Memory allocation failed: '%s'", zip_path);
+            goto _fail;
+        }
+
+        tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+        size_t input_pos = 0, input_avail = 0;
+        tinfl_init(decomp);
+
+        while (status == TINFL_STATUS_NEEDS_MORE_INPUT || (status == TINFL_STATUS_HAS_MORE_OUTPUT && output_buffer_pos < output_buffer_size))
+        {
+            if (input_avail == 0 && stream_remaining > 0)
+            {
+                input_avail = RG_MIN(read_buffer_size, stream_remaining);
+                input_pos = 0;
+                if (fread(read_buffer, input_avail, 1, fp) != 1)
+                {
+                    RG_LOGE("Read error (%d): '%s'", errno, zip_path);
+                    goto _fail;
+                }
+                stream_remaining -= input_avail;
+            }
+            size_t input_size = input_avail;
+            size_t output_size = output_buffer_size - output_buffer_pos;
+            status = tinfl_decompress(
+                decomp, read_buffer + input_pos, &input_size, output_buffer, output_buffer + output_buffer_pos, &output_size,
+                TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | (stream_remaining ? TINFL_FLAG_HAS_MORE_INPUT : 0));
+            input_pos += input_size;
+            input_avail -= input_size;
+            output_buffer_pos += output_size;
+            if (status == TINFL_STATUS_NEEDS_MORE_INPUT && input_avail == 0 && stream_remaining == 0)
+                break;
+        }
+
+        // With user-provided buffer we might not reach TINFL_STATUS_DONE, but it doesn't mean we've failed
+        if (status < TINFL_STATUS_DONE || output_buffer_pos != output_buffer_size)
+        {
+            RG_LOGE("Decompression failed (%d): %s", (int)status, zip_path);
+            goto _fail;
+        }
+    }
+
+    if (output_buffer_size == entry.uncompressed_size && rg_crc32(0, output_buffer, output_buffer_size) != entry.checksum)
+    {
+        RG_LOGE("Checksum mismatch: '%s'", zip_path);
+        goto _fail;
+    }
+
+    free(read_buffer);
+    free(decomp);
+    fclose(fp);
+
+    *data_out = output_buffer;
+    *data_len = output_buffer_size;
+    return true;
+
+_fail:
+    if (!(flags & RG_FILE_USER_BUFFER))
+        free(output_buffer);
+    free(read_buffer);
+    free(decomp);
+    fclose(fp);
+    return false;
+}
+#else
+bool rg_storage_unzip_file(const char *zip_path, const char *filter, void **data_out, size_t *data_len, uint32_t flags)
+{
+    RG_LOGE("ZIP support hasn't been enabled!");
+    return false;
+}
+#endif
+
+/**
+ * Streams are read through fp, either directly or through tinfl for deflated zip entries. Inflating
+ * uses a wrapping dictionary so only the compressed stream position and the last 32KB are kept.
+ */
+struct rg_stream_source_s
+{
+    FILE *fp;
+    long data_offset;
+    long file_pos;
+#if RG_ZIP_SUPPORT
+    tinfl_decompressor *decomp;
+    uint8_t *dict;
+    uint8_t *input;
+    size_t input_pos;
+    size_t input_avail;
+    size_t compressed_size;
+    size_t compressed_remaining;
+    size_t output_pos;
+    size_t dict_pos;
+#endif
+};
+
+static bool stream_read_raw(struct rg_stream_source_s *source, size_t offset, void *buffer, size_t length)
+{
+    long pos = source->data_offset + offset;
+    if (source->file_pos != pos && fseek(source->fp, pos, SEEK_SET) != 0)
+        return false;
+    size_t len = fread(buffer, 1, length, source->fp);
+    source->file_pos = pos + len;
+    return len == length;
+}
+
+#if RG_ZIP_SUPPORT
+static bool stream_read_deflated(struct rg_stream_source_s *source, size_t offset, uint8_t *buffer, size_t length)
+{
+    const size_t input_size = 0x4000;
+
+    if (offset < source->output_pos)
+    {
+        RG_LOGD("Restarting inflate to reach offset %d", (int)offset);
+        tinfl_init(source->decomp);
+        source->input_avail = 0;
+        source->compressed_remaining = source->compressed_size;
+        source->output_pos = 0;
+        source->dict_pos = 0;
+        source->file_pos = -1;
+    }
+
+    while (source->output_pos < offset + length)
+    {
+        if (source->input_avail == 0 && source->compressed_remaining > 0)
+        {
+            size_t len = RG_MIN(input_size, source->compressed_remaining);
+            if (!stream_read_raw(source, source->compressed_size - source->compressed_remaining, source->input, len))
+                return false;
+            source->input_pos = 0;
+            source->input_avail = len;
+            source->compressed_remaining -= len;
+        }
+
+        size_t in_size = source->input_avail;
+        size_t out_size = TINFL_LZ_DICT_SIZE - source->dict_pos;
+        tinfl_status status = tinfl_decompress(source->decomp, source->input + source->input_pos, &in_size,
+                                               source->dict, source->dict + source->dict_pos, &out_size,
+                                               source->compressed_remaining ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+        source->input_pos += in_size;
+        source->input_avail -= in_size;
+
+        // Copy whatever part of the requested range was just produced
+        size_t start = RG_MAX(source->output_pos, offset);
+        size_t end = RG_MIN(source->output_pos + out_size, offset + length);
+        if (end > start)
+            memcpy(buffer + (start - offset), source->dict + source->dict_pos + (start - source->output_pos), end - start);
+
+        source->output_pos += out_size;
+        source->dict_pos = (source->dict_pos + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status < TINFL_STATUS_DONE || (status == TINFL_STATUS_DONE && source->output_pos < offset + length)
+            || (status == TINFL_STATUS_NEEDS_MORE_INPUT && source->input_avail == 0 && source->compressed_remaining == 0))
+        {
+            RG_LOGE("Decompression failed (%d)", (int)status);
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+static bool stream_read(rg_stream_t *stream, size_t offset, uint8_t *buffer, size_t length)
+{
+#if RG_ZIP_SUPPORT
+    if (stream->source->decomp)
+        return stream_read_deflated(stream->source, offset, buffer, length);
+#endif
+    return stream_read_raw(stream->source, offset, buffer, length);
+}
+
+static uint8_t *stream_load_page(rg_stream_t *stream, size_t page, bool evict)
+{
+    uint8_t *buffer = NULL;
+
+    if (stream->loaded < stream->max_pages)
+        buffer = malloc(stream->page_size);
+
+    if (!buffer)
+    {
+        if (!evict)
+            return NULL;
+        size_t victim = stream->page_count;
+        for (size_t i = 0; i < stream->page_count; ++i)
+        {
+            if (stream->pages[i] && (victim == stream->page_count || stream->last_used[i] < stream->last_used[victim]))
+                victim = i;
+        }
+        if (victim == stream->page_count)
+        {
+            RG_LOGE("Out of memory for page %d!", (int)page);
+            return NULL;
+        }
+        RG_LOGD("Evicting page %d for page %d", (int)victim, (int)page);
+        buffer = stream->pages[victim];
+        stream->pages[victim] = NULL;
+        stream->loaded--;
+    }
+
+    size_t offset = page * stream->page_size;
+    size_t length = RG_MIN(stream->page_size, stream->size - offset);
+    if (!stream_read(stream, offset, buffer, length))
+    {
+        RG_LOGE("Read error (%d) on page %d", errno, (int)page);
+        free(buffer);
+        return NULL;
+    }
+    memset(buffer + length, 0xFF, stream->page_size - length);
+
+    stream->pages[page] = buffer;
+    stream->loaded++;
+    rg_stream_touch(stream, page);
+    return buffer;
+}
+
+rg_stream_t *rg_stream_open(const char *path, const char *filter, size_t page_size, size_t max_pages)
+{
+    RG_ASSERT_ARG(path && page_size);
+
+    rg_stream_t *stream = calloc(1, sizeof(rg_stream_t));
+    struct rg_stream_source_s *source = calloc(1, sizeof(struct rg_stream_source_s));
+    if (!stream || !source)
+        goto _fail;
+
+    stream->source = source;
+    stream->page_size = page_size;
+    source->fp = fopen(path, "rb");
+    source->file_pos = -1;
+
+    if (!source->fp)
+    {
+        RG_LOGE("Fopen failed (%d): '%s'", errno, path);
+        goto _fail;
+    }
+
+    if (rg_extension_match(path, "zip"))
+    {
+    #if RG_ZIP_SUPPORT
+        zip_entry_t entry = {0};
+        if (!zip_find_entry(source->fp, filter, &entry))
+            goto _fail;
+        if (entry.compression == MZ_DEFLATED)
+        {
+            source->decomp = malloc(sizeof(tinfl_decompressor));
+            source->dict = malloc(TINFL_LZ_DICT_SIZE);
+            source->input = malloc(0x4000);
+            if (!source->decomp || !source->dict || !source->input)
+                goto _fail;
+            tinfl_init(source->decomp);
+            source->compressed_size = entry.compressed_size;
+            source->compressed_remaining = entry.compressed_size;
+        }
+        else if (entry.compression != 0)
+        {
+            RG_LOGE("Unsupported compression method %d: '%s'", entry.compression, path);
+            goto _fail;
+        }
+        RG_LOGI("Streaming '%s' from '%s'", entry.name, path);
+        source->data_offset = entry.data_offset;
+        stream->size = entry.uncompressed_size;
+    #else
+        RG_LOGE("ZIP support hasn't been enabled!");
+        goto _fail;
+    #endif
+    }
+    else
+    {
+        if (fseek(source->fp, 0, SEEK_END) != 0)
+            goto _fail;
+        stream->size = ftell(source->fp);
+    }
+
+    stream->page_count = (stream->size + page_size - 1) / page_size;
+    stream->max_pages = max_pages ? RG_MIN(max_pages, stream->page_count) : stream->page_count;
+    stream->pages = calloc(stream->page_count + 1, sizeof(uint8_t *));
+    stream->last_used = calloc(stream->page_count + 1, sizeof(uint32_t));
+    if (!stream->pages || !stream->last_used)
+        goto _fail;
+
+    RG_LOGI("Opened '%s', size: %d, pages: %d x %d", path, (int)stream->size, (int)stream->page_count, (int)page_size);
+    return stream;
+
+_fail:
+    RG_LOGE("Failed to open stream: '%s'", path);
+    rg_stream_close(stream);
+    return NULL;
+}
+
+uint8_t *rg_stream_get_page(rg_stream_t *stream, size_t page)
+{
+    RG_ASSERT_ARG(stream);
+    if (page >= stream->page_count)
+        return NULL;
+    if (stream->pages[page])
+    {
+        rg_stream_touch(stream, page);
+        return stream->pages[page];
+    }
+    return stream_load_page(stream, page, true);
+}
+
+bool rg_stream_prefetch(rg_stream_t *stream, size_t page)
+{
+    RG_ASSERT_ARG(stream);
+    if (page >= stream->page_count)
+        return false;
+    return stream->pages[page] || stream_load_page(stream, page, false);
+}
+
+size_t rg_stream_read(rg_stream_t *stream, size_t offset, void *buffer, size_t length)
+{
+    RG_ASSERT_ARG(stream && buffer);
+    size_t done = 0;
+    while (done < length && offset + done < stream->size)
+    {
+        size_t pos = offset + done;
+        uint8_t *page = rg_stream_get_page(stream, pos / stream->page_size);
+        if (!page)
+            break;
+        size_t len = RG_MIN(length - done, stream->page_size - pos % stream->page_size);
+        len = RG_MIN(len, stream->size - pos);
+        memcpy((uint8_t *)buffer + done, page + pos % stream->page_size, len);
+        done += len;
+    }
+    return done;
+}
+
+void rg_stream_close(rg_stream_t *stream)
+{
+    if (!stream)
+        return;
+    if (stream->pages)
+    {
+        for (size_t i = 0; i < stream->page_count; ++i)
+            free(stream->pages[i]);
+    }
+    if (stream->source)
+    {
+        if (stream->source->fp)
+            fclose(stream->source->fp);
+    #if RG_ZIP_SUPPORT
+        free(stream->source->decomp);
+        free(stream->source->dict);
+        free(stream->source->input);
+    #endif
+        free(stream->source);
+    }
+    free(stream->pages);
+    free(stream->last_used);
+    free(stream);
+}
+
+/**
+ * ROM cache partition: a romcache_header_t alone in the first sector, the data starts at the next 64KB
+ * boundary because that's the MMU page size. The header is written last so an interrupted copy is ignored.
+ */
+#define ROMCACHE_MAGIC 0x43524752 // "RGRC"
+#define ROMCACHE_DATA_OFFSET 0x10000
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t checksum;
+    uint32_t data_size;
+    uint32_t file_size;
+    uint32_t file_mtime;
+    char path[RG_PATH_MAX + 1];
+} romcache_header_t;
+
+static struct
+{
+    const void *data;
+    size_t size;
+#if defined(ESP_PLATFORM) && ESP_IDF_VERSION_MAJOR < 5
+    spi_flash_mmap_handle_t handle;
+#elif defined(ESP_PLATFORM)
+    esp_partition_mmap_handle_t handle;
+#endif
+} rom_mapping;
+
+bool rg_storage_cache_rom(const char *path, const char *filter, uint32_t checksum)
+{
+    CHECK_PATH(path);
+#ifdef ESP_PLATFORM
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, RG_STORAGE_ROM_PARTITION);
+    if (!part)
+        return false;
+
+    rg_stat_t info = rg_storage_stat(path);
+    romcache_header_t header = {0};
+    if (!info.is_file || esp_partition_read(part, 0, &header, sizeof(header)) != ESP_OK)
+        return false;
+
+    if (header.magic == ROMCACHE_MAGIC && header.file_size == info.size)
+    {
+        if (header.file_mtime == (uint32_t)info.mtime && strcmp(header.path, path) == 0)
+        {
+            RG_LOGI("'%s' is already in the ROM cache", path);
+            return true;
+        }
+        if (checksum && header.checksum == checksum)
+        {
+            // Same content under another name or date, only the header needs updating
+            RG_LOGI("'%s' is already in the ROM cache as '%s'", path, header.path);
+            header.file_mtime = info.mtime;
+            snprintf(header.path, sizeof(header.path), "%s", path);
+            return esp_partition_erase_range(part, 0, ROMCACHE_DATA_OFFSET) == ESP_OK
+                && esp_partition_write(part, 0, &header, sizeof(header)) == ESP_OK;
+        }
+    }
+
+    rg_stream_t *stream = rg_stream_open(path, filter, 0x8000, 1);
+    if (!stream)
+        return false;
+
+    if (ROMCACHE_DATA_OFFSET + stream->size > part->size)
+    {
+        RG_LOGW("'%s' doesn't fit in the ROM cache (%d > %d)", path, (int)stream->size, (int)(part->size - ROMCACHE_DATA_OFFSET));
+        rg_stream_close(stream);
+        return false;
+    }
+
+    RG_LOGI("Copying '%s' to the ROM cache (%d bytes)...", path, (int)stream->size);
+    int64_t start_time = rg_system_timer();
+    size_t erase_size = (stream->size + 0xFFF) & ~0xFFF;
+    bool success = esp_partition_erase_range(part, 0, ROMCACHE_DATA_OFFSET + erase_size) == ESP_OK;
+
+    for (size_t i = 0; success && i < stream->page_count; ++i)
+    {
+        const uint8_t *page = rg_stream_get_page(stream, i);
+        size_t length = RG_MIN(stream->page_size, stream->size - i * stream->page_size);
+        success = page && esp_partition_write(part, ROMCACHE_DATA_OFFSET + i * stream->page_size, page, length) == ESP_OK;
+    }
+
+    if (success)
+    {
+        header = (romcache_header_t){
+            .magic = ROMCACHE_MAGIC,
+            .checksum = checksum,
+            .data_size = stream->size,
+            .file_size = info.size,
+            .file_mtime = info.mtime,
+        };
+        snprintf(header.path, sizeof(header.path), "%s", path);
+        success = esp_partition_write(part, 0, &header, sizeof(header)) == ESP_OK;
+    }
+    rg_stream_close(stream);
+
+    if (!success)
+    {
+        RG_LOGE("Copy to the ROM cache failed!");
+        return false;
+    }
+
+    RG_LOGI("Copy completed in %dms", (int)((rg_system_timer() - start_time) / 1000));
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool rg_storage_map_rom(const char *path, const void **data_out, size_t *data_len)
+{
+    RG_ASSERT_ARG(data_out && data_len);
+    CHECK_PATH(path);
+    rg_storage_unmap_rom();
+#ifdef ESP_PLATFORM
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, RG_STORAGE_ROM_PARTITION);
+    if (!part)
+        return false;
+
+    rg_stat_t info = rg_storage_stat(path);
+    romcache_header_t header = {0};
+    if (esp_partition_read(part, 0, &header, sizeof(header)) != ESP_OK || header.magic != ROMCACHE_MAGIC
+        || header.file_size != info.size || header.file_mtime != (uint32_t)info.mtime || strcmp(header.path, path) != 0)
+        return false;
+
+    esp_err_t err = esp_partition_mmap(part, ROMCACHE_DATA_OFFSET, header.data_size, ESP_PARTITION_MMAP_DATA, data_out, &rom_mapping.handle);
+    if (err != ESP_OK)
+    {
+        RG_LOGE("Mapping failed (0x%x): '%s'", err, path);
+        return false;
+    }
+    *data_len = header.data_size;
+#elif !defined(_WIN32)
+    // Archives have to be extracted, they can't be mapped as is
+    if (rg_extension_match(path, "zip"))
+        return false;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    size_t size = ftell(fp);
+    void *data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0) : MAP_FAILED;
+    fclose(fp);
+    if (data == MAP_FAILED)
+    {
+        RG_LOGE("Mapping failed (%d): '%s'", errno, path);
+        return false;
+    }
+    *data_out = data;
+    *data_len = size;
+#else
+    return false;
 #endif
+    rom_mapping.data = *data_out;
+    rom_mapping.size = *data_len;
+    RG_LOGI("Mapped '%s' at %p (%d bytes)", path, *data_out, (int)*data_len);
+    return true;
+}
+
+void rg_storage_unmap_rom(void)
+{
+    if (!rom_mapping.data)
+        return;
+#if defined(ESP_PLATFORM) && ESP_IDF_VERSION_MAJOR < 5
+    spi_flash_munmap(rom_mapping.handle);
+#elif defined(ESP_PLATFORM)
+    esp_partition_munmap(rom_mapping.handle);
+#elif !defined(_WIN32)
+    munmap((void *)rom_mapping.data, rom_mapping.size);
+#endif
+    RG_LOGI("Unmapped ROM at %p", rom_mapping.data);
+    memset(&rom_mapping, 0, sizeof(rom_mapping));
+}
+
+/**
+ * Save state container. A state_header_t followed by chunks, each being a state_chunk_t and its data.
+ * Compression only uses the miniz primitives found in ESP32's ROM, same as the unzip above.
+ */
+#define STATE_MAGIC "RGST"
+#define STATE_VERSION 1
+
+typedef struct __attribute__((packed))
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+} state_header_t;
+
+typedef struct __attribute__((packed))
+{
+    char tag[4];
+    uint16_t version;  // Version of the section's content, it's up to the caller
+    uint16_t flags;    // RG_STATE_COMPRESS
+    uint32_t size;     // Size in the file
+    uint32_t raw_size; // Size once decompressed
+    uint32_t checksum; // CRC32 of the decompressed data
+} state_chunk_t;
+
+struct rg_state_file_s
+{
+    FILE *fp;
+    bool error;
+#if RG_ZIP_SUPPORT
+    tdefl_compressor *comp;
+    size_t comp_size;
+#endif
+};
+
+#if RG_ZIP_SUPPORT
+static mz_bool state_write_cb(const void *data, int len, void *arg)
+{
+    rg_state_writer_t *writer = arg;
+    writer->comp_size += len;
+    return fwrite(data, len, 1, writer->fp) == 1;
+}
+#endif
+
+rg_state_writer_t *rg_state_writer_open(const char *path)
+{
+    RG_ASSERT_ARG(path);
+
+    rg_state_writer_t *writer = calloc(1, sizeof(rg_state_writer_t));
+    if (!writer || !(writer->fp = fopen(path, "wb")))
+    {
+        RG_LOGE("Fopen failed (%d): '%s'", errno, path);
+        free(writer);
+        return NULL;
+    }
+
+    // Compressed chunks come out in small pieces, this turns them into cluster-sized writes
+    setvbuf(writer->fp, NULL, _IOFBF, RG_STORAGE_IO_CHUNK_SIZE);
+
+    state_header_t header = {STATE_MAGIC, STATE_VERSION, 0};
+    writer->error = fwrite(&header, sizeof(header), 1, writer->fp) != 1;
+    return writer;
+}
+
+bool rg_state_write_chunk(rg_state_writer_t *writer, const char *tag, uint16_t version, const void *data, size_t data_len, uint32_t flags)
+{
+    RG_ASSERT_ARG(writer && tag && (data || !data_len));
+
+    state_chunk_t chunk = {
+        .version = version,
+        .size = data_len,
+        .raw_size = data_len,
+        .checksum = rg_crc32(0, data, data_len),
+    };
+    memcpy(chunk.tag, tag, 4);
+
+    long chunk_pos = ftell(writer->fp);
+
+    if (writer->error || fwrite(&chunk, sizeof(chunk), 1, writer->fp) != 1)
+        goto _fail;
+
+#if RG_ZIP_SUPPORT
+    // The compressor is fairly large, it's only allocated once and we do without if memory is short
+    if ((flags & RG_STATE_COMPRESS) && !writer->comp)
+        writer->comp = rg_alloc(sizeof(tdefl_compressor), MEM_SLOW | MEM_NOPANIC);
+
+    if ((flags & RG_STATE_COMPRESS) && writer->comp)
+    {
+        // A single probe with greedy parsing (zlib's level 1), states compress well even at that level
+        writer->comp_size = 0;
+        tdefl_init(writer->comp, &state_write_cb, writer, 1 | TDEFL_GREEDY_PARSING_FLAG);
+        if (tdefl_compress_buffer(writer->comp, data, data_len, TDEFL_FINISH) != TDEFL_STATUS_DONE)
+            goto _fail;
+        chunk.flags = RG_STATE_COMPRESS;
+        chunk.size = writer->comp_size;
+        // Now that we know the compressed size we can complete the chunk header
+        if (fseek(writer->fp, chunk_pos, SEEK_SET) != 0 || fwrite(&chunk, sizeof(chunk), 1, writer->fp) != 1
+            || fseek(writer->fp, 0, SEEK_END) != 0)
+            goto _fail;
+    }
+    else
+#endif
+    if (data_len && fwrite(data, data_len, 1, writer->fp) != 1)
+        goto _fail;
+
+    RG_LOGD("Chunk '%.4s' written, size: %d => %d", chunk.tag, (int)chunk.raw_size, (int)chunk.size);
+    return true;
+
+_fail:
+    RG_LOGE("Chunk '%.4s' write failed (%d)", chunk.tag, errno);
+    writer->error = true;
+    return false;
+}
+
+bool rg_state_writer_close(rg_state_writer_t *writer)
+{
+    if (!writer)
+        return false;
+    bool success = fclose(writer->fp) == 0 && !writer->error;
+#if RG_ZIP_SUPPORT
+    free(writer->comp);
+#endif
+    free(writer);
+    return success;
+}
+
+rg_state_reader_t *rg_state_reader_open(const char *path)
+{
+    RG_ASSERT_ARG(path);
+
+    state_header_t header;
+    FILE *fp = fopen(path, "rb");
+    if (!fp && errno == ENOENT && rg_storage_restore_backup(path))
+        fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, STATE_MAGIC, 4) != 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    if (header.version > STATE_VERSION)
+    {
+        RG_LOGE("Unsupported state version %d: '%s'", header.version, path);
+        fclose(fp);
+        return NULL;
+    }
+
+    rg_state_reader_t *reader = calloc(1, sizeof(rg_state_reader_t));
+    if (!reader)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    reader->fp = fp;
+    return reader;
+}
+
+bool rg_state_read_chunk(rg_state_reader_t *reader, const char *tag, uint16_t *version, void **data_out, size_t *data_len)
+{
+    RG_ASSERT_ARG(reader && tag && data_out && data_len);
+
+    uint8_t *output = NULL, *input = NULL;
+    state_chunk_t chunk;
+
+    // Chunks are few and small enough that a linear search from the start is fine
+    fseek(reader->fp, sizeof(state_header_t), SEEK_SET);
+    while (true)
+    {
+        if (fread(&chunk, sizeof(chunk), 1, reader->fp) != 1)
+        {
+            RG_LOGD("Chunk '%.4s' not found", tag);
+            return false;
+        }
+        if (memcmp(chunk.tag, tag, 4) == 0)
+            break;
+        if (fseek(reader->fp, chunk.size, SEEK_CUR) != 0)
+            return false;
+    }
+
+    output = malloc(RG_MAX(chunk.raw_size, 1));
+    input = (chunk.flags & RG_STATE_COMPRESS) ? malloc(RG_MAX(chunk.size, 1)) : output;
+    if (!output || !input)
+    {
+        RG_LOGE("Memory allocation failed: '%.4s'", chunk.tag);
+        goto _fail;
+    }
+
+    if (chunk.size && fread(input, chunk.size, 1, reader->fp) != 1)
+    {
+        RG_LOGE("Read error (%d): '%.4s'", errno, chunk.tag);
+        goto _fail;
+    }
+
+    if (chunk.flags & RG_STATE_COMPRESS)
+    {
+#if RG_ZIP_SUPPORT
+        tinfl_decompressor *decomp = malloc(sizeof(tinfl_decompressor));
+        size_t input_size = chunk.size, output_size = chunk.raw_size;
+        tinfl_status status = TINFL_STATUS_FAILED;
+        if (decomp)
+        {
+            tinfl_init(decomp);
+            status = tinfl_decompress(decomp, input, &input_size, output, output, &output_size,
+                                      TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+        }
+        free(decomp);
+        if (status != TINFL_STATUS_DONE || output_size != chunk.raw_size)
+        {
+            RG_LOGE("Decompression failed (%d): '%.4s'", (int)status, chunk.tag);
+            goto _fail;
+        }
+        free(input);
+        input = NULL;
+#else
+        RG_LOGE("ZIP support hasn't been enabled!");
+        goto _fail;
+#endif
+    }
+    else if (chunk.size != chunk.raw_size)
+    {
+        RG_LOGE("Invalid chunk size: '%.4s'", chunk.tag);
+        goto _fail;
+    }
+
+    if (rg_crc32(0, output, chunk.raw_size) != chunk.checksum)
+    {
+        RG_LOGE("Checksum mismatch: '%.4s'", chunk.tag);
+        goto _fail;
+    }
+
+    if (version)
+        *version = chunk.version;
+    *data_out = output;
+    *data_len = chunk.raw_size;
+    return true;
+
+_fail:
+    if (input != output)
+        free(input);
+    free(output);
+    return false;
+}
+
+void rg_state_reader_close(rg_state_reader_t *reader)
+{
+    if (!reader)
+        return;
+    fclose(reader->fp);
+    free(reader);
+}
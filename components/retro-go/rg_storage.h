@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
 #define RG_BASE_PATH        RG_STORAGE_ROOT "/retro-go"
@@ -73,8 +74,113 @@ enum
     RG_FILE_ALIGN_32KB = (1 << 2),      // Will align/pad data_out to 32KB (not applicable if RG_FILE_USER_BUFFER)
     RG_FILE_ALIGN_64KB = (1 << 3),      // Will align/pad data_out to 64KB (not applicable if RG_FILE_USER_BUFFER)
     RG_FILE_USER_BUFFER = (1 << 4),     // Will use *data_out and *data_len provided by the user
-    RG_FILE_ATOMIC_WRITE = (1 << 5),    // Will write to a temp file before replacing the target
+    RG_FILE_ATOMIC_WRITE = (1 << 5),    // Will write to a temp file then replace the target (see rg_storage_replace)
 };
 bool rg_storage_read_file(const char *path, void **data_out, size_t *data_len, uint32_t flags);
 bool rg_storage_write_file(const char *path, const void *data_ptr, size_t data_len, uint32_t flags);
+// Moves source over target. Where rename can't replace a file (FAT) target is kept aside as target.bak
+// until source is in place. If power is lost in between, rg_storage_restore_backup (done by
+// rg_storage_read_file and the state reader when the target is missing) puts the old file back.
+bool rg_storage_replace(const char *source, const char *target);
+bool rg_storage_restore_backup(const char *path); // Returns true if path was missing and restored
+// filter is a list of extensions (eg "nes fds") used to pick the entry, NULL picks the first file
 bool rg_storage_unzip_file(const char *zip_path, const char *filter, void **data_out, size_t *data_len, uint32_t flags);
+// Wraps a memory buffer in a FILE, used to reuse file-based serializers for in-memory states
+FILE *rg_storage_memopen(void *buffer, size_t size, const char *mode);
+
+// Background I/O. Requests run one at a time on the storage task, highest priority first, and their
+// callback is called from that task (or from rg_storage_cancel's caller, with success = false).
+enum
+{
+    RG_STORAGE_PRIORITY_LOW = 0,    // Read-ahead, cover art
+    RG_STORAGE_PRIORITY_NORMAL = 1, // Save states
+    RG_STORAGE_PRIORITY_HIGH = 2,   // Anything that shouldn't wait (battery-backed RAM always goes first)
+};
+typedef bool rg_storage_job_t(void *arg);
+typedef void rg_storage_cb_t(void *arg, bool success);
+typedef void rg_storage_read_cb_t(void *arg, const char *path, void *data, size_t data_len); // data is NULL on failure, free() it
+bool rg_storage_queue(rg_storage_job_t *job, rg_storage_cb_t *callback, void *arg, int priority);
+bool rg_storage_read_file_async(const char *path, uint32_t flags, int priority, rg_storage_read_cb_t *callback, void *arg);
+bool rg_storage_write_file_async(const char *path, void *data, size_t data_len, uint32_t flags, int priority, rg_storage_cb_t *callback, void *arg); // Takes ownership of data
+void rg_storage_cancel(void *arg); // Drops the requests queued with arg that haven't started yet
+void rg_storage_wait_idle(void);
+
+// ROMs copied once to the RG_STORAGE_ROM_PARTITION flash partition can be mapped read-only instead of
+// loaded in RAM. The copy is skipped when the partition already holds that file (or checksum, if not 0).
+// On SDL2 the file itself is mapped. The mapping is read-only, one ROM can be mapped at a time and it
+// lasts until rg_storage_unmap_rom or unmount.
+bool rg_storage_cache_rom(const char *path, const char *filter, uint32_t checksum);
+bool rg_storage_map_rom(const char *path, const void **data_out, size_t *data_len);
+void rg_storage_unmap_rom(void);
+
+// Battery-backed RAM mirrored to a file. Only the pages that changed are written back, either by the
+// storage task once they've been dirty for a few seconds, by rg_sram_flush, or at unmount.
+// Apps mark the pages they write with rg_sram_mark, or use RG_SRAM_AUTODETECT if they can't.
+// The storage task never reads the live data, the pages are copied by rg_sram_tick between frames.
+typedef struct
+{
+    char *path;
+    uint8_t *data;
+    size_t size;
+    uint32_t flags;
+    int page_shift;
+    volatile uint32_t dirty; // One bit per page
+    uint32_t *checksums;     // RG_SRAM_AUTODETECT only
+    bool complete;           // The file contains all the pages
+    int64_t dirty_since;
+    uint8_t *snapshot;                // Copy of the pages waiting to be written
+    volatile uint32_t snapshot_pages; // One bit per page held in snapshot
+    volatile bool snapshot_due;       // Set by the storage task, the next rg_sram_tick takes the copy
+    bool (*write_extra)(FILE *fp); // Called after the pages with fp at the end of them (eg: RTC)
+} rg_sram_t;
+enum
+{
+    RG_SRAM_AUTODETECT = (1 << 0), // Compare page checksums instead of relying on rg_sram_mark
+};
+rg_sram_t *rg_sram_open(const char *path, void *data, size_t size, uint32_t flags); // Loads the file if present
+bool rg_sram_load(rg_sram_t *sram);  // Reloads the file, discarding changes
+bool rg_sram_flush(rg_sram_t *sram); // Writes the dirty pages now
+bool rg_sram_is_dirty(rg_sram_t *sram);
+void rg_sram_close(rg_sram_t *sram); // Flushes and releases the tracker, not the data
+void rg_sram_set_autosave(int seconds); // 0 disables the background flush (default RG_SRAM_AUTOSAVE_DELAY)
+void rg_sram_tick(void); // Called by rg_system_tick, on the emulator's thread, between frames
+#define rg_sram_mark(sram, offset) ((sram)->dirty |= 1u << ((offset) >> (sram)->page_shift))
+
+// Read-only file (or zip entry) accessed in fixed-size pages that are loaded on demand. When memory or
+// max_pages runs out the least recently used page is evicted, callers must then reload it through
+// rg_stream_get_page. Deflated zip entries work too but going backward means inflating from the start.
+// Only gnuboy's bank loader and the ROM cache copy use it. The other cores keep raw pointers into the
+// whole ROM and would need a page miss path in their mappers first.
+typedef struct
+{
+    uint8_t **pages;      // Resident pages, NULL when not loaded
+    uint32_t *last_used;  // See rg_stream_touch
+    uint32_t clock;
+    size_t size;
+    size_t page_size;
+    size_t page_count;
+    size_t max_pages;
+    size_t loaded;
+    struct rg_stream_source_s *source;
+} rg_stream_t;
+rg_stream_t *rg_stream_open(const char *path, const char *filter, size_t page_size, size_t max_pages);
+uint8_t *rg_stream_get_page(rg_stream_t *stream, size_t page); // Loads the page if needed, NULL on error
+bool rg_stream_prefetch(rg_stream_t *stream, size_t page); // Loads the page only if it doesn't evict another
+size_t rg_stream_read(rg_stream_t *stream, size_t offset, void *buffer, size_t length);
+void rg_stream_close(rg_stream_t *stream);
+#define rg_stream_touch(stream, page) ((stream)->last_used[page] = ++(stream)->clock)
+
+// Chunked container used by save states: a small header followed by tagged and versioned sections,
+// each optionally deflated. Readers look sections up by tag and skip the ones they don't know.
+typedef struct rg_state_file_s rg_state_writer_t;
+typedef struct rg_state_file_s rg_state_reader_t;
+enum
+{
+    RG_STATE_COMPRESS = (1 << 0), // Deflate the section (stored as is if compression isn't available)
+};
+rg_state_writer_t *rg_state_writer_open(const char *path);
+bool rg_state_write_chunk(rg_state_writer_t *writer, const char *tag, uint16_t version, const void *data, size_t data_len, uint32_t flags);
+bool rg_state_writer_close(rg_state_writer_t *writer); // Returns false if any write failed
+rg_state_reader_t *rg_state_reader_open(const char *path); // Returns NULL if path isn't a state container
+bool rg_state_read_chunk(rg_state_reader_t *reader, const char *tag, uint16_t *version, void **data_out, size_t *data_len);
+void rg_state_reader_close(rg_state_reader_t *reader);
@@ -77,6 +77,74 @@ void rg_surface_free(rg_surface_t *surface)
     free(surface);
 }
 
+typedef struct
+{
+    enum {COPY_STEP, COPY_REPEAT, COPY_MAP} mode; // src_x = x * factor, x / factor, map[x]
+    int width, factor;
+    const int16_t *map;
+    const uint16_t *palette; // Already converted to the output byte order
+} copy_line_t;
+
+#define PIXEL_PAL(i) (palette[src[(i)]])
+#define PIXEL_565(i) (src[(i)])
+#define PIXEL_565_SWAP(i) ({ uint16_t v = src[(i)]; (uint16_t)((v << 8) | (v >> 8)); })
+#define PIXEL_888(i) ({ const uint8_t *p = &src[(i) * 3]; (uint16_t)(((p[0] << 8) & 0xF800) | ((p[1] << 3) & 0x7E0) | (p[2] >> 3)); })
+
+// Line converters output copy->width 565 pixels, scaled horizontally
+#define DEFINE_COPY_LINE(NAME, SRC_TYPE, PIXEL)                                            \
+    static void copy_line_##NAME(uint16_t *dst, const void *line, const copy_line_t *copy) \
+    {                                                                                      \
+        const SRC_TYPE *src = line;                                                        \
+        const uint16_t *palette = copy->palette;                                           \
+        const int width = copy->width, factor = copy->factor;                              \
+        (void)palette;                                                                     \
+        if (copy->mode == COPY_STEP)                                                       \
+        {                                                                                  \
+            for (int x = 0, src_x = 0; x < width; ++x, src_x += factor)                    \
+                dst[x] = PIXEL(src_x);                                                     \
+        }                                                                                  \
+        else if (copy->mode == COPY_REPEAT)                                                \
+        {                                                                                  \
+            for (int x = 0, src_x = 0; x < width; ++src_x)                                 \
+            {                                                                              \
+                uint16_t pixel = PIXEL(src_x);                                             \
+                for (int n = RG_MIN(factor, width - x); n > 0; --n)                        \
+                    dst[x++] = pixel;                                                      \
+            }                                                                              \
+        }                                                                                  \
+        else                                                                               \
+        {                                                                                  \
+            const int16_t *map = copy->map;                                                \
+            for (int x = 0; x < width; ++x)                                                \
+                dst[x] = PIXEL(map[x]);                                                    \
+        }                                                                                  \
+    }
+
+DEFINE_COPY_LINE(pal, uint8_t, PIXEL_PAL)
+DEFINE_COPY_LINE(565, uint16_t, PIXEL_565)
+DEFINE_COPY_LINE(565_swap, uint16_t, PIXEL_565_SWAP)
+DEFINE_COPY_LINE(888, uint8_t, PIXEL_888)
+
+// Unscaled 888 to 565 LE, 4 pixels at a time (3 words in, 2 words out)
+static void copy_line_888_1x(uint16_t *dst, const void *line, const copy_line_t *copy)
+{
+    const uint8_t *src = line;
+    int x = 0;
+    for (; x + 4 <= copy->width; x += 4, src += 12)
+    {
+        uint32_t w[3];
+        memcpy(w, src, 12); // The source isn't necessarily aligned
+        uint32_t p0 = ((w[0] << 8) & 0xF800) | ((w[0] >> 5) & 0x7E0) | ((w[0] >> 19) & 0x1F);
+        uint32_t p1 = ((w[0] >> 16) & 0xF800) | ((w[1] << 3) & 0x7E0) | ((w[1] >> 11) & 0x1F);
+        uint32_t p2 = ((w[1] >> 8) & 0xF800) | ((w[1] >> 21) & 0x7E0) | ((w[2] >> 3) & 0x1F);
+        uint32_t p3 = (w[2] & 0xF800) | ((w[2] >> 13) & 0x7E0) | (w[2] >> 27);
+        uint32_t out[2] = {p0 | (p1 << 16), p2 | (p3 << 16)}; // Both of our targets are little endian
+        memcpy(&dst[x], out, 8);
+    }
+    for (; x < copy->width; ++x, src += 3)
+        dst[x] = ((src[0] << 8) & 0xF800) | ((src[1] << 3) & 0x7E0) | (src[2] >> 3);
+}
+
 bool rg_surface_copy(const rg_surface_t *source, const rg_rect_t *source_rect, rg_surface_t *dest,
                      const rg_rect_t *dest_rect, bool scale)
 {
@@ -98,7 +166,6 @@ bool rg_surface_copy(const rg_surface_t *source, const rg_rect_t *source_rect, r
 
     int copy_width = dest->width;
     int copy_height = dest->height;
-    int transparency = -1;
 
     if (source->width == copy_width && source->height == copy_height)
     {
@@ -112,47 +179,7 @@ bool rg_surface_copy(const rg_surface_t *source, const rg_rect_t *source_rect, r
             copy_height = source->height;
     }
 
-    float step_x = (float)source->width / copy_width;
-    float step_y = (float)source->height / copy_height;
-
-    // This may look weird but it avoids up to 75k branches and float multiplications...
-    // Maybe there's a better way, without making it even more macro-heavy...
-    short src_x_map[copy_width];
-    for (int x = 0; x < copy_width; ++x)
-        src_x_map[x] = scale ? (int)(x * step_x) : x;
-
-    #define COPY_PIXELS_1(SRC_PIXEL, DST_PIXEL)                                            \
-        for (int y = 0; y < copy_height; ++y)                                              \
-        {                                                                                  \
-            int src_y = scale ? (y * step_y) : y;                                          \
-            const uint8_t *src = source->data + source->offset + (src_y * source->stride); \
-            uint8_t *dst = dest->data + dest->offset + (y * dest->stride);                 \
-            for (int x = 0; x < copy_width; ++x)                                           \
-            {                                                                              \
-                int src_x = (int)src_x_map[x];                                             \
-                uint16_t pixel = SRC_PIXEL;                                                \
-                if ((int)pixel == transparency)                                            \
-                    continue;                                                              \
-                DST_PIXEL;                                                                 \
-            }                                                                              \
-        }
-
-    #define COPY_PIXELS(SRC_PIXEL)                                                                   \
-        if (dest->format == RG_PIXEL_565_LE)                                                         \
-        {                                                                                            \
-            COPY_PIXELS_1(SRC_PIXEL, ((uint16_t *)dst)[x] = pixel);                                  \
-        }                                                                                            \
-        else if (dest->format == RG_PIXEL_565_BE)                                                    \
-        {                                                                                            \
-            COPY_PIXELS_1(SRC_PIXEL, ((uint16_t *)dst)[x] = (pixel << 8) | (pixel >> 8));            \
-        }                                                                                            \
-        else if (dest->format == RG_PIXEL_888)                                                       \
-        {                                                                                            \
-            COPY_PIXELS_1(SRC_PIXEL, *dst++ = ((pixel >> 8) & 0xF8); *dst++ = ((pixel >> 3) & 0xFC); \
-                        *dst++ = ((pixel & 0x1F) << 3););                                            \
-        }
-
-    if (source->format == dest->format && !scale && transparency == -1)
+    if (source->format == dest->format && !scale)
     {
         for (int y = 0; y < copy_height; ++y)
         {
@@ -160,29 +187,40 @@ bool rg_surface_copy(const rg_surface_t *source, const rg_rect_t *source_rect, r
             uint8_t *dst = dest->data + dest->offset + (y * dest->stride);
             memcpy(dst, src, copy_width * RG_PIXEL_GET_SIZE(dest->format));
         }
+        return true;
     }
-    else if (source->format == RG_PIXEL_565_LE)
-    {
-        COPY_PIXELS(((uint16_t *)src)[src_x]);
-    }
-    else if (source->format == RG_PIXEL_565_BE)
+
+    if (dest->format != RG_PIXEL_565_LE && dest->format != RG_PIXEL_565_BE && dest->format != RG_PIXEL_888)
     {
-        COPY_PIXELS(((uint16_t *)src)[src_x]; pixel = (pixel << 8) | (pixel >> 8));
+        RG_LOGE("Unsupported destination format %d", dest->format);
+        return false;
     }
-    else if (source->format == RG_PIXEL_PAL565_LE)
+
+    // Lines are converted to 565 in the destination's byte order (LE for 888, it's expanded afterwards)
+    bool dest_be = dest->format == RG_PIXEL_565_BE;
+    void (*copy_line)(uint16_t *, const void *, const copy_line_t *) = NULL;
+    uint16_t palette[256];
+    int16_t map[copy_width];
+
+    copy_line_t copy = {COPY_STEP, copy_width, 1, map, palette};
+
+    if (source->format == RG_PIXEL_PAL565_LE || source->format == RG_PIXEL_PAL565_BE)
     {
-        COPY_PIXELS(source->palette[src[src_x]]);
+        // Swapping the 256 palette entries once is cheaper than swapping every pixel
+        bool swap = (source->format == RG_PIXEL_PAL565_BE) != dest_be;
+        for (int i = 0; i < 256; ++i)
+            palette[i] = swap ? (source->palette[i] << 8) | (source->palette[i] >> 8) : source->palette[i];
+        copy_line = &copy_line_pal;
     }
-    else if (source->format == RG_PIXEL_PAL565_BE)
+    else if (source->format == RG_PIXEL_565_LE || source->format == RG_PIXEL_565_BE)
     {
-        COPY_PIXELS(source->palette[src[src_x]]; pixel = (pixel << 8) | (pixel >> 8));
+        bool swap = (source->format == RG_PIXEL_565_BE) != dest_be;
+        copy_line = swap ? &copy_line_565_swap : &copy_line_565;
     }
     else if (source->format == RG_PIXEL_888)
     {
-        COPY_PIXELS(({
-            const uint8_t *pix = &src[src_x * 3];
-            (((pix[0] << 8) & 0xF800) | ((pix[1] << 3) & 0x7E0) | (((pix[2] >> 3) & 0x1F)));
-        }));
+        // Always outputs 565 LE, swapped afterwards if needed
+        copy_line = scale ? &copy_line_888 : &copy_line_888_1x;
     }
     else
     {
@@ -190,6 +228,60 @@ bool rg_surface_copy(const rg_surface_t *source, const rg_rect_t *source_rect, r
         return false;
     }
 
+    if (scale && copy_width % source->width == 0)
+    {
+        copy.mode = COPY_REPEAT;
+        copy.factor = copy_width / source->width;
+    }
+    else if (scale && source->width % copy_width == 0)
+    {
+        copy.factor = source->width / copy_width;
+    }
+    else if (scale)
+    {
+        copy.mode = COPY_MAP;
+        for (int x = 0; x < copy_width; ++x)
+            map[x] = x * source->width / copy_width;
+    }
+
+    uint16_t line_buffer[dest->format == RG_PIXEL_888 ? copy_width : 1];
+    int prev_src_y = -1;
+
+    for (int y = 0; y < copy_height; ++y)
+    {
+        int src_y = scale ? y * source->height / copy_height : y;
+        const uint8_t *src = source->data + source->offset + (src_y * source->stride);
+        uint8_t *dst = dest->data + dest->offset + (y * dest->stride);
+
+        if (src_y == prev_src_y)
+        {
+            memcpy(dst, dst - dest->stride, copy_width * RG_PIXEL_GET_SIZE(dest->format));
+            continue;
+        }
+        prev_src_y = src_y;
+
+        if (dest->format == RG_PIXEL_888)
+        {
+            copy_line(line_buffer, src, &copy);
+            for (int x = 0; x < copy_width; ++x)
+            {
+                uint16_t pixel = line_buffer[x];
+                *dst++ = ((pixel >> 8) & 0xF8);
+                *dst++ = ((pixel >> 3) & 0xFC);
+                *dst++ = ((pixel & 0x1F) << 3);
+            }
+        }
+        else
+        {
+            copy_line((uint16_t *)dst, src, &copy);
+            if (dest_be && source->format == RG_PIXEL_888)
+            {
+                for (int x = 0; x < copy_width; ++x)
+                    ((uint16_t *)dst)[x] = (((uint16_t *)dst)[x] << 8) | (((uint16_t *)dst)[x] >> 8);
+            }
+        }
+    }
+
     return true;
 }
 
@@ -218,6 +310,32 @@ rg_surface_t *rg_surface_convert(const rg_surface_t *source, int new_width, int
     return dest;
 }
 
+bool rg_surface_diff_lines(const rg_surface_t *previous, const rg_surface_t *current, uint32_t *dirty_lines)
+{
+    RG_ASSERT_ARG(previous && current && dirty_lines);
+
+    if (previous == current || previous->width != current->width || previous->height != current->height || previous->format != current->format
+        || previous->stride != current->stride || previous->offset != current->offset)
+        return false;
+
+    // A palette change affects every line without changing the pixels
+    if ((current->format & RG_PIXEL_PALETTE) && previous->palette != current->palette
+        && memcmp(previous->palette, current->palette, 256 * 2) != 0)
+        return false;
+
+    const size_t line_size = current->width * RG_PIXEL_GET_SIZE(current->format);
+    const uint8_t *prev = previous->data + previous->offset;
+    const uint8_t *curr = current->data + current->offset;
+
+    memset(dirty_lines, 0, (current->height + 31) / 32 * 4);
+    for (int y = 0; y < current->height; ++y)
+    {
+        if (memcmp(prev + y * current->stride, curr + y * current->stride, line_size) != 0)
+            dirty_lines[y >> 5] |= 1u << (y & 31);
+    }
+    return true;
+}
+
 bool rg_surface_fill(rg_surface_t *dest, const rg_rect_t *rect, rg_color_t color)
 {
     CHECK_SURFACE(dest, false);
@@ -54,6 +54,9 @@ void rg_surface_free(rg_surface_t *surface);
 bool rg_surface_copy(const rg_surface_t *source, const rg_rect_t *source_rect, rg_surface_t *dest,
                      const rg_rect_t *dest_rect, bool scale);
 bool rg_surface_fill(rg_surface_t *dest, const rg_rect_t *rect, rg_color_t color);
+// Sets a bit in dirty_lines for every line that differs. Returns false if the surfaces can't be compared line
+// by line (size, format or palette differ), then every line must be considered dirty.
+bool rg_surface_diff_lines(const rg_surface_t *previous, const rg_surface_t *current, uint32_t *dirty_lines);
 rg_surface_t *rg_surface_convert(const rg_surface_t *source, int new_width, int new_height, int new_format);
 #define rg_surface_resize(source, new_width, new_height) rg_surface_convert(source, new_width, new_height, RG_PIXEL_565_LE)
 bool rg_surface_save_image_file(const rg_surface_t *source, const char *filename, int width, int height);
@@ -46,6 +46,7 @@ typedef struct
 {
     int32_t totalFrames, fullFrames, partFrames, ticks;
     int64_t busyTime, updateTime;
+    int64_t audioDriverTime, audioDriverCalls;
 } counters_t;
 
 struct rg_task_s
@@ -57,8 +58,10 @@ struct rg_task_s
     QueueHandle_t queue;
     TaskHandle_t handle;
 #else
-    rg_task_msg_t msg;
-    int msgWaiting;
+    SDL_mutex *lock;
+    SDL_cond *cond; // Signaled whenever a message is added or removed
+    rg_task_msg_t queue[RG_TASK_QUEUE_LENGTH];
+    size_t queueHead, queueCount;
     SDL_threadID handle;
 #endif
     char name[16];
@@ -81,6 +84,22 @@ static struct
 } *profile;
 #endif
 
+#ifdef RG_ENABLE_BENCHMARK
+static struct
+{
+    int64_t time_started;
+    int64_t last_tick;
+    int frameskip;
+    int max_frames;
+    int frames;
+    FILE *hash_file;
+    int hash_interval;
+    uint32_t video_crc;
+    uint32_t audio_crc;
+    uint32_t frame_time[];
+} *benchmark;
+#endif
+
 // The trace will survive a software reset
 static RTC_NOINIT_ATTR panic_trace_t panicTrace;
 // static RTC_NOINIT_ATTR boot_config_t bootConfig;
@@ -90,7 +109,44 @@ static bool exitCalled = false;
 static uint32_t indicators;
 static rg_color_t ledColor = -1;
 static rg_stats_t statistics;
+static volatile bool statistics_updated; // The emulator thread redraws the status overlay, see rg_system_tick
 static rg_app_t app;
+static struct
+{
+    int64_t deadline;
+    int64_t audioSamples;
+    bool enabled;
+} pacing;
+static struct
+{
+    uint8_t *ring;     // Compressed XOR deltas, each one turns a snapshot into the one before it
+    uint8_t *current;  // Latest snapshot, zero padded up to capacity
+    uint8_t *scratch;
+    size_t capacity;
+    size_t current_size;
+    size_t write_pos;
+    struct {uint32_t offset, size, prev_size;} *entries;
+    size_t first, count;
+    int frames;
+    uint32_t hotkey;
+    bool enabled;
+    bool rewinding;
+    bool held;
+} rewind_state;
+static struct
+{
+    uint8_t *buffer;
+    size_t capacity;
+    int frames;
+    bool supported;
+} runahead;
+static struct
+{
+    volatile int queued;    // Only written by the caller
+    volatile int completed; // Only written by the storage task
+    volatile int progress;
+    volatile bool failed;
+} state_writer;
 static rg_task_t tasks[8];
 
 static const char *SETTING_BOOT_NAME = "BootName";
@@ -98,6 +154,8 @@ static const char *SETTING_BOOT_ARGS = "BootArgs";
 static const char *SETTING_BOOT_FLAGS = "BootFlags";
 static const char *SETTING_TIMEZONE = "Timezone";
 static const char *SETTING_INDICATOR_MASK = "Indicators";
+static const char *SETTING_REWIND = "RewindHotkey";
+static const char *SETTING_RUNAHEAD = "RunAhead";
 
 #define logbuf_putc(buf, c) (buf)->console[(buf)->cursor++] = c, (buf)->cursor %= RG_LOGBUF_SIZE;
 #define logbuf_puts(buf, str) for (const char *ptr = str; *ptr; ptr++) logbuf_putc(buf, *ptr);
@@ -180,7 +238,7 @@ static void update_statistics(void)
     const counters_t previous = counters;
 
     rg_display_counters_t display = rg_display_get_counters();
-    // rg_audio_counters_t audio = rg_audio_get_counters();
+    rg_audio_counters_t audio = rg_audio_get_counters();
 
     counters.totalFrames = display.totalFrames;
     counters.fullFrames = display.fullFrames;
@@ -188,6 +246,8 @@ static void update_statistics(void)
     counters.busyTime = statistics.busyTime;
     counters.ticks = statistics.ticks;
     counters.updateTime = statistics.lastTick;
+    counters.audioDriverTime = audio.driverTime;
+    counters.audioDriverCalls = audio.driverCalls;
 
     // We prefer to use the tick time for more accurate FPS
     // but if we're not ticking, we need to use current time
@@ -213,6 +273,15 @@ static void update_statistics(void)
         statistics.fullFPS = fullFrames / totalTimeSecs;
         statistics.partialFPS = partFrames / totalTimeSecs;
     }
+    if (counters.audioDriverCalls > previous.audioDriverCalls)
+    {
+        statistics.audioSubmitTime = (counters.audioDriverTime - previous.audioDriverTime) /
+                                     (counters.audioDriverCalls - previous.audioDriverCalls);
+    }
+    statistics.audioUnderruns = audio.underruns;
+    statistics.audioOverruns = audio.overruns;
+    statistics.audioQueueDepth = audio.queueDepth * 100 / RG_AUDIO_BUFFER_LENGTH;
+    statistics.audioLatency = audio.latency;
     statistics.uptime = rg_system_timer() / 1000000;
 
     update_memory_statistics();
@@ -254,7 +323,10 @@ static void system_monitor_task(void *arg)
         nextLoopTime = rg_system_timer() + 1000000;
         rtcValue = time(NULL);
 
+    #ifndef RG_ENABLE_BENCHMARK // The benchmark computes its statistics over the whole run instead
         update_statistics();
+        statistics_updated = true;
+    #endif
         // update_indicators(); // Implicitly called by rg_system_set_indicator below
 
         rg_battery_t battery = rg_input_read_battery();
@@ -263,7 +335,8 @@ static void system_monitor_task(void *arg)
                                                            !rg_system_get_indicator(RG_INDICATOR_POWER_LOW)));
 
         // Try to avoid complex conversions that could allocate, prefer rounding/ceiling if necessary.
-        rg_system_log(RG_LOG_DEBUG, NULL, "STACK:%d, HEAP:%d+%d (%d+%d), BUSY:%d%%, FPS:%d (%d+%d+%d), BATT:%d\n",
+        rg_system_log(RG_LOG_DEBUG, NULL, "STACK:%d, HEAP:%d+%d (%d+%d), BUSY:%d%%, FPS:%d (%d+%d+%d), "
+            "AUDIO:%d%% %dms (U:%d O:%d %dus), BATT:%d\n",
             statistics.freeStackMain,
             statistics.freeMemoryInt / 1024,
             statistics.freeMemoryExt / 1024,
@@ -274,6 +347,11 @@ static void system_monitor_task(void *arg)
             (int)roundf(statistics.skippedFPS),
             (int)roundf(statistics.partialFPS),
             (int)roundf(statistics.fullFPS),
+            statistics.audioQueueDepth,
+            statistics.audioLatency / 1000,
+            statistics.audioUnderruns,
+            statistics.audioOverruns,
+            statistics.audioSubmitTime,
             (int)roundf((battery.volts * 1000) ?: battery.level));
 
         // Auto frameskip
@@ -322,6 +400,111 @@ static void system_monitor_task(void *arg)
     }
 }
 
+#ifdef RG_ENABLE_BENCHMARK
+static int compare_frame_time(const void *a, const void *b)
+{
+    return *(const uint32_t *)a - *(const uint32_t *)b;
+}
+
+static void benchmark_report(void)
+{
+    size_t count = benchmark->frames;
+    int64_t totalTime = benchmark->last_tick - benchmark->time_started;
+    rg_display_counters_t display = rg_display_get_counters();
+    rg_audio_counters_t audio = rg_audio_get_counters();
+
+    qsort(benchmark->frame_time, count, sizeof(uint32_t), compare_frame_time);
+    update_statistics();
+
+    printf("RGD:BENCH:RESULT app=%s frames=%d time=%dus fps=%.2f min=%dus p50=%dus p99=%dus max=%dus\n",
+        app.configNs, (int)count, (int)totalTime, count / (totalTime / 1000000.0),
+        (int)benchmark->frame_time[0],
+        (int)benchmark->frame_time[count / 2],
+        (int)benchmark->frame_time[count * 99 / 100],
+        (int)benchmark->frame_time[count - 1]);
+    printf("RGD:BENCH:STATS busy=%.1f%% totalFPS=%.1f skippedFPS=%.1f partialFPS=%.1f fullFPS=%.1f "
+           "busyTime=%dus ticks=%d stack=%d\n",
+        statistics.busyPercent, statistics.totalFPS, statistics.skippedFPS, statistics.partialFPS,
+        statistics.fullFPS, (int)statistics.busyTime, statistics.ticks, statistics.freeStackMain);
+    printf("RGD:BENCH:DISPLAY frames=%d full=%d part=%d busyTime=%dus blockTime=%dus\n",
+        (int)display.totalFrames, (int)display.fullFrames, (int)display.partFrames,
+        (int)display.busyTime, (int)display.blockTime);
+    printf("RGD:BENCH:AUDIO samples=%d busyTime=%dus\n", (int)audio.totalSamples, (int)audio.busyTime);
+    fflush(stdout);
+}
+
+static void benchmark_tick(void)
+{
+    int64_t now = statistics.lastTick;
+
+    // Hashes are only reproducible if the same frames are drawn, time-based frameskip must be avoided
+    if (benchmark->frameskip < 0 && benchmark->hash_file)
+        benchmark->frameskip = RG_MAX(app.frameskip, 1);
+    if (benchmark->frameskip >= 0)
+        app.frameskip = benchmark->frameskip;
+
+    if (benchmark->hash_file && statistics.ticks % benchmark->hash_interval == 0)
+    {
+        fprintf(benchmark->hash_file, "%d %08X %08X\n", statistics.ticks, (unsigned)benchmark->video_crc,
+                (unsigned)benchmark->audio_crc);
+        benchmark->audio_crc = 0;
+    }
+
+    // The first tick only marks the start, everything before it is boot time
+    if (benchmark->last_tick)
+        benchmark->frame_time[benchmark->frames++] = now - benchmark->last_tick;
+    else
+    {
+        benchmark->time_started = now;
+        update_statistics();
+    }
+    benchmark->last_tick = now;
+
+    if (benchmark->frames >= benchmark->max_frames)
+    {
+        benchmark_report();
+        if (benchmark->hash_file)
+            fclose(benchmark->hash_file);
+        exit(0);
+    }
+}
+
+void rg_system_benchmark_hash(bool audio, uint32_t crc)
+{
+    if (!benchmark || !benchmark->hash_file)
+        return;
+    if (audio)
+        benchmark->audio_crc = rg_crc32(benchmark->audio_crc, (const uint8_t *)&crc, sizeof(crc));
+    else
+        benchmark->video_crc = crc;
+}
+
+static void benchmark_init(void)
+{
+    // The runner is configured from the environment, see tools/bench_sdl2.sh
+    const char *frames = getenv("RG_BENCH_FRAMES");
+    const char *frameskip = getenv("RG_BENCH_FRAMESKIP");
+    const char *hash_file = getenv("RG_BENCH_HASH");
+    const char *hash_interval = getenv("RG_BENCH_HASH_INTERVAL");
+    int max_frames = RG_MAX(frames ? atoi(frames) : 1000, 1);
+
+    app.configNs = getenv("RG_BENCH_APP") ?: app.configNs;
+    app.bootArgs = getenv("RG_BENCH_ROM") ?: app.bootArgs;
+    app.bootFlags = 0;
+
+    benchmark = calloc(1, sizeof(*benchmark) + max_frames * sizeof(uint32_t));
+    RG_ASSERT(benchmark, "Out of memory!");
+    benchmark->max_frames = max_frames;
+    benchmark->frameskip = frameskip ? atoi(frameskip) : -1;
+    benchmark->hash_interval = RG_MAX(hash_interval ? atoi(hash_interval) : 60, 1);
+    if (hash_file && hash_file[0] && !(benchmark->hash_file = fopen(hash_file, "w")))
+        RG_PANIC("Unable to create hash file!");
+
+    RG_LOGI("Benchmark mode: app='%s' rom='%s' frames=%d frameskip=%d\n", app.configNs,
+            app.bootArgs ?: "", benchmark->max_frames, benchmark->frameskip);
+}
+#endif
+
 static void enter_recovery_mode(void)
 {
     RG_LOGW("Entering recovery mode...\n");
@@ -365,8 +548,10 @@ static void platform_init(void)
         gpio_set_level(RG_GPIO_LED, 0);
     #endif
 #elif defined(RG_TARGET_SDL2)
-    freopen("stdout.txt", "w", stdout);
-    freopen("stderr.txt", "w", stderr);
+    #ifndef RG_ENABLE_BENCHMARK // The benchmark report goes to the console
+        freopen("stdout.txt", "w", stdout);
+        freopen("stderr.txt", "w", stderr);
+    #endif
     SDL_SetMainReady();
     if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO) < 0)
         RG_PANIC("SDL Init failed!");
@@ -464,6 +649,9 @@ rg_app_t *rg_system_init(int sampleRate, const rg_handlers_t *handlers, void *_u
     app.configNs = rg_settings_get_string(NS_BOOT, SETTING_BOOT_NAME, app.configNs);
     app.bootArgs = rg_settings_get_string(NS_BOOT, SETTING_BOOT_ARGS, app.bootArgs);
     app.bootFlags = rg_settings_get_number(NS_BOOT, SETTING_BOOT_FLAGS, app.bootFlags);
+#ifdef RG_ENABLE_BENCHMARK
+    benchmark_init();
+#endif
     rg_display_init();
     rg_gui_init();
 
@@ -496,6 +684,9 @@ rg_app_t *rg_system_init(int sampleRate, const rg_handlers_t *handlers, void *_u
     app.indicatorsMask = rg_settings_get_number(NS_GLOBAL, SETTING_INDICATOR_MASK, app.indicatorsMask);
     app.saveSlot = (app.bootFlags & RG_BOOT_SLOT_MASK) >> 4;
     app.romPath = app.bootArgs ?: ""; // For whatever reason some of our code isn't NULL-aware, sigh..
+    rewind_state.hotkey = app.lowMemoryMode ? 0 : rg_settings_get_number(NS_APP, SETTING_REWIND, 0);
+    rewind_state.enabled = rewind_state.hotkey != 0;
+    runahead.frames = app.lowMemoryMode ? 0 : RG_MIN(RG_MAX(rg_settings_get_number(NS_APP, SETTING_RUNAHEAD, 0), 0), 2);
 
     rg_gui_draw_hourglass();
     rg_audio_init(sampleRate);
@@ -537,7 +728,6 @@ static void task_wrapper(void *arg)
 {
     rg_task_t *task = arg;
     task->handle = xTaskGetCurrentTaskHandle();
-    task->queue = xQueueCreate(1, sizeof(rg_task_msg_t));
     (task->func)(task->arg);
     vQueueDelete(task->queue);
     memset(task, 0, sizeof(rg_task_t));
@@ -549,6 +739,8 @@ static int task_wrapper(void *arg)
     rg_task_t *task = arg;
     task->handle = SDL_ThreadID();
     (task->func)(task->arg);
+    SDL_DestroyCond(task->cond);
+    SDL_DestroyMutex(task->lock);
     memset(task, 0, sizeof(rg_task_t));
     return 0;
 }
@@ -573,17 +765,24 @@ rg_task_t *rg_task_create(const char *name, void (*taskFunc)(void *arg), void *a
     task->handle = 0;
     strncpy(task->name, name, 15);
 
+    // The queue must exist before the task starts, messages can be sent to it right away
 #if defined(ESP_PLATFORM)
     TaskHandle_t handle = NULL;
     if (affinity < 0)
         affinity = tskNO_AFFINITY;
+    task->queue = xQueueCreate(RG_TASK_QUEUE_LENGTH, sizeof(rg_task_msg_t));
     if (xTaskCreatePinnedToCore(task_wrapper, name, stackSize, task, priority, &handle, affinity) == pdPASS)
         return task;
+    vQueueDelete(task->queue);
 #elif defined(RG_TARGET_SDL2)
+    task->lock = SDL_CreateMutex();
+    task->cond = SDL_CreateCond();
     SDL_Thread *thread = SDL_CreateThread(task_wrapper, name, task);
     SDL_DetachThread(thread);
     if (thread)
         return task;
+    SDL_DestroyCond(task->cond);
+    SDL_DestroyMutex(task->lock);
 #endif
 
     RG_LOGE("Task creation failed: name='%s', fn='%p', stack=%d\n", name, taskFunc, (int)stackSize);
@@ -618,21 +817,47 @@ rg_task_t *rg_task_current(void)
     return NULL;
 }
 
-bool rg_task_send(rg_task_t *task, const rg_task_msg_t *msg)
+#if defined(RG_TARGET_SDL2)
+// Waits (with task->lock held) until the queue isn't `full` or empty anymore. Returns false on timeout.
+static bool task_queue_wait(rg_task_t *task, bool full, int timeoutMS)
+{
+    uint32_t deadline = SDL_GetTicks() + timeoutMS;
+    while (full ? task->queueCount >= RG_TASK_QUEUE_LENGTH : task->queueCount == 0)
+    {
+        if (timeoutMS < 0)
+            SDL_CondWait(task->cond, task->lock);
+        else if ((int32_t)(deadline - SDL_GetTicks()) <= 0)
+            return false;
+        else
+            SDL_CondWaitTimeout(task->cond, task->lock, deadline - SDL_GetTicks());
+    }
+    return true;
+}
+#endif
+
+bool rg_task_send(rg_task_t *task, const rg_task_msg_t *msg, int timeoutMS)
 {
     RG_ASSERT_ARG(task && msg);
 #if defined(ESP_PLATFORM)
-    return xQueueSend(task->queue, msg, portMAX_DELAY) == pdTRUE;
+    int timeout = timeoutMS >= 0 ? pdMS_TO_TICKS(timeoutMS) : portMAX_DELAY;
+    return xQueueSend(task->queue, msg, timeout) == pdTRUE;
 #elif defined(RG_TARGET_SDL2)
-    while (task->msgWaiting > 0)
-        continue;
-    task->msg = *msg;
-    task->msgWaiting = 1;
-    return true;
+    if (!task->lock)
+        return false;
+    SDL_LockMutex(task->lock);
+    bool success = task_queue_wait(task, true, timeoutMS);
+    if (success)
+    {
+        task->queue[(task->queueHead + task->queueCount) % RG_TASK_QUEUE_LENGTH] = *msg;
+        task->queueCount++;
+        SDL_CondBroadcast(task->cond);
+    }
+    SDL_UnlockMutex(task->lock);
+    return success;
 #endif
 }
 
-bool rg_task_peek(rg_task_msg_t *out)
+bool rg_task_peek(rg_task_msg_t *out, int timeoutMS)
 {
     rg_task_t *task = rg_task_current();
     bool success = false;
@@ -640,17 +865,21 @@ bool rg_task_peek(rg_task_msg_t *out)
         return false;
     // task->blocked = true;
 #if defined(ESP_PLATFORM)
-    success = xQueuePeek(task->queue, out, portMAX_DELAY) == pdTRUE;
+    int timeout = timeoutMS >= 0 ? pdMS_TO_TICKS(timeoutMS) : portMAX_DELAY;
+    success = xQueuePeek(task->queue, out, timeout) == pdTRUE;
 #elif defined(RG_TARGET_SDL2)
-    while (task->msgWaiting < 1)
-        continue;
-    *out = task->msg;
+    if (!task->lock)
+        return false;
+    SDL_LockMutex(task->lock);
+    if ((success = task_queue_wait(task, false, timeoutMS)))
+        *out = task->queue[task->queueHead];
+    SDL_UnlockMutex(task->lock);
 #endif
     // task->blocked = false;
     return success;
 }
 
-bool rg_task_receive(rg_task_msg_t *out)
+bool rg_task_receive(rg_task_msg_t *out, int timeoutMS)
 {
     rg_task_t *task = rg_task_current();
     bool success = false;
@@ -658,12 +887,20 @@ bool rg_task_receive(rg_task_msg_t *out)
         return false;
     // task->blocked = true;
 #if defined(ESP_PLATFORM)
-    success = xQueueReceive(task->queue, out, portMAX_DELAY) == pdTRUE;
+    int timeout = timeoutMS >= 0 ? pdMS_TO_TICKS(timeoutMS) : portMAX_DELAY;
+    success = xQueueReceive(task->queue, out, timeout) == pdTRUE;
 #elif defined(RG_TARGET_SDL2)
-    while (task->msgWaiting < 1)
-        continue;
-    *out = task->msg;
-    task->msgWaiting = 0;
+    if (!task->lock)
+        return false;
+    SDL_LockMutex(task->lock);
+    if ((success = task_queue_wait(task, false, timeoutMS)))
+    {
+        *out = task->queue[task->queueHead];
+        task->queueHead = (task->queueHead + 1) % RG_TASK_QUEUE_LENGTH;
+        task->queueCount--;
+        SDL_CondBroadcast(task->cond);
+    }
+    SDL_UnlockMutex(task->lock);
 #endif
     // task->blocked = false;
     return success;
@@ -673,9 +910,14 @@ size_t rg_task_messages_waiting(rg_task_t *task)
 {
     if (!task) task = rg_task_current();
 #if defined(ESP_PLATFORM)
-    return uxQueueMessagesWaiting(task->queue);
+    return task->queue ? uxQueueMessagesWaiting(task->queue) : 0;
 #elif defined(RG_TARGET_SDL2)
-    return task->msgWaiting;
+    if (!task->lock)
+        return 0;
+    SDL_LockMutex(task->lock);
+    size_t count = task->queueCount;
+    SDL_UnlockMutex(task->lock);
+    return count;
 #endif
 }
 
@@ -739,7 +981,16 @@ bool rg_mutex_take(rg_mutex_t *mutex, int timeoutMS)
     int timeout = timeoutMS >= 0 ? pdMS_TO_TICKS(timeoutMS) : portMAX_DELAY;
     return xSemaphoreTake((QueueHandle_t)mutex, timeout) == pdPASS;
 #elif defined(RG_TARGET_SDL2)
-    return SDL_LockMutex((SDL_mutex *)mutex) == 0;
+    if (timeoutMS < 0)
+        return SDL_LockMutex((SDL_mutex *)mutex) == 0;
+    int64_t deadline = rg_system_timer() + timeoutMS * 1000LL;
+    while (SDL_TryLockMutex((SDL_mutex *)mutex) != 0)
+    {
+        if (rg_system_timer() >= deadline)
+            return false;
+        SDL_Delay(1);
+    }
+    return true;
 #endif
 }
 
@@ -818,12 +1069,258 @@ int rg_system_get_tick_rate(void)
     return app.tickRate;
 }
 
+void rg_system_set_tick_pacing(bool enable)
+{
+    pacing.deadline = rg_system_timer();
+    pacing.enabled = enable;
+}
+
+static void tick_pacing(void)
+{
+    // The audio device's clock is the reference: the audio buffer slowly fills up if we run faster than it and
+    // drains if we're slower. rg_audio resamples by up to 0.5% to absorb that, but if the difference is larger
+    // the buffer drifts away from half full and we nudge the frame time by up to 2%.
+    int64_t audioSamples = rg_audio_get_counters().totalSamples;
+    float audioUsage = rg_audio_get_buffer_usage();
+    int frameTime = app.frameTime;
+    if (audioSamples != pacing.audioSamples && (audioUsage < 0.25f || audioUsage > 0.75f))
+        frameTime *= 1.f + (audioUsage - 0.5f) * 0.04f;
+    pacing.audioSamples = audioSamples;
+    int64_t now = rg_system_timer();
+
+    pacing.deadline += frameTime;
+
+    if (pacing.deadline > now)
+        rg_usleep(pacing.deadline - now);
+    else if (now - pacing.deadline > app.frameTime * 4)
+        pacing.deadline = now; // Too far behind (loading, menu, etc), don't try to catch up
+}
+
+#define REWIND_MAX_ENTRIES 512
+#define MEM_STATE_MAX_SIZE (1024 * 1024)
+
+static void rewind_free(void)
+{
+    free(rewind_state.ring);
+    free(rewind_state.current);
+    free(rewind_state.scratch);
+    free(rewind_state.entries);
+    rewind_state.ring = rewind_state.current = rewind_state.scratch = NULL;
+    rewind_state.entries = NULL;
+    rewind_state.capacity = rewind_state.current_size = rewind_state.write_pos = 0;
+    rewind_state.first = rewind_state.count = 0;
+    rewind_state.rewinding = false;
+}
+
+static bool rewind_alloc(size_t capacity)
+{
+    rewind_free();
+    rewind_state.ring = rg_alloc(RG_REWIND_BUFFER_SIZE, MEM_SLOW | MEM_NOPANIC);
+    rewind_state.current = rg_alloc(capacity, MEM_SLOW | MEM_NOPANIC);
+    rewind_state.scratch = rg_alloc(capacity, MEM_SLOW | MEM_NOPANIC);
+    rewind_state.entries = rg_alloc(REWIND_MAX_ENTRIES * sizeof(*rewind_state.entries), MEM_SLOW | MEM_NOPANIC);
+    if (!rewind_state.ring || !rewind_state.current || !rewind_state.scratch || !rewind_state.entries)
+    {
+        RG_LOGE("Not enough memory for rewind!");
+        rewind_free();
+        return false;
+    }
+    rewind_state.capacity = capacity;
+    RG_LOGI("Rewind buffer: %dKB, state buffer: %dKB", RG_REWIND_BUFFER_SIZE / 1024, (int)capacity / 1024);
+    return true;
+}
+
+static void rewind_xor(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4)
+        *(uint32_t *)(dst + i) ^= *(const uint32_t *)(src + i);
+    for (; i < len; i++)
+        dst[i] ^= src[i];
+}
+
+// The XOR of two consecutive snapshots is mostly zeroes, it is stored as a series of
+// (u16 zeroes count, u16 literals count, literals). Output is at most len + 4 * (len / 0xFFFF + 2).
+static size_t rewind_encode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    uint8_t *out = dst;
+    size_t pos = 0;
+
+    while (pos < len)
+    {
+        size_t start = pos, max = RG_MIN(len, start + 0xFFFF);
+        while (pos < max && (pos & 3) && !src[pos])
+            pos++;
+        if (!(pos & 3)) // Word loads must be aligned on the ESP32
+            while (pos + 4 <= max && !*(const uint32_t *)(src + pos))
+                pos += 4;
+        while (pos < max && !src[pos])
+            pos++;
+        size_t zeroes = pos - start;
+
+        // Literals absorb short runs of zeroes, it isn't worth starting a new block for them
+        start = pos, max = RG_MIN(len, start + 0xFFFF);
+        while (pos < max)
+        {
+            if (src[pos])
+            {
+                pos++;
+                continue;
+            }
+            size_t end = RG_MIN(pos + 8, len), next = pos;
+            while (next < end && !src[next])
+                next++;
+            if (next == end)
+                break;
+            pos = RG_MIN(next, max);
+        }
+        size_t literals = pos - start;
+
+        out[0] = zeroes, out[1] = zeroes >> 8;
+        out[2] = literals, out[3] = literals >> 8;
+        memcpy(out + 4, src + start, literals);
+        out += 4 + literals;
+    }
+
+    return out - dst;
+}
+
+static void rewind_apply(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    const uint8_t *end = src + size;
+    while (src < end)
+    {
+        dst += src[0] | (src[1] << 8);
+        size_t literals = src[2] | (src[3] << 8);
+        src += 4;
+        while (literals--)
+            *dst++ ^= *src++;
+    }
+}
+
+static void rewind_capture(void)
+{
+    size_t size = rewind_state.capacity;
+
+    if (!app.handlers.saveStateMem(rewind_state.scratch, &size) || size > rewind_state.capacity)
+    {
+        // Most likely the state didn't fit, start over with a bigger buffer
+        if (rewind_state.capacity >= MEM_STATE_MAX_SIZE || !rewind_alloc(rewind_state.capacity * 2))
+        {
+            RG_LOGE("Unable to save state, rewind disabled!");
+            rewind_free();
+            rewind_state.enabled = false;
+        }
+        return;
+    }
+
+    rewind_state.rewinding = false;
+
+    if (rewind_state.current_size == 0)
+    {
+        memcpy(rewind_state.current, rewind_state.scratch, size);
+        rewind_state.current_size = size;
+        return;
+    }
+
+    size_t len = RG_MAX(size, rewind_state.current_size);
+    size_t bound = len + 4 * (len / 0xFFFF + 2);
+    size_t start = rewind_state.write_pos;
+    bool wrapped = false;
+
+    if (bound > RG_REWIND_BUFFER_SIZE / 2)
+    {
+        RG_LOGE("State is too big for the rewind buffer, rewind disabled!");
+        rewind_free();
+        rewind_state.enabled = false;
+        return;
+    }
+
+    if (start + bound > RG_REWIND_BUFFER_SIZE)
+    {
+        start = 0;
+        wrapped = true;
+    }
+
+    // Entries following the write position are the oldest ones, drop them until we have room
+    while (rewind_state.count > 0)
+    {
+        size_t offset = rewind_state.entries[rewind_state.first].offset;
+        size_t end = offset + rewind_state.entries[rewind_state.first].size;
+        bool overlaps = offset < start + bound && end > start;
+        if (rewind_state.count < REWIND_MAX_ENTRIES && !overlaps && !(wrapped && offset >= rewind_state.write_pos))
+            break;
+        rewind_state.first = (rewind_state.first + 1) % REWIND_MAX_ENTRIES;
+        rewind_state.count--;
+    }
+
+    memset(rewind_state.scratch + size, 0, len - size);
+    rewind_xor(rewind_state.scratch, rewind_state.current, len);
+
+    size_t used = rewind_encode(rewind_state.scratch, len, rewind_state.ring + start);
+    size_t index = (rewind_state.first + rewind_state.count++) % REWIND_MAX_ENTRIES;
+    rewind_state.entries[index].offset = start;
+    rewind_state.entries[index].size = used;
+    rewind_state.entries[index].prev_size = rewind_state.current_size;
+    rewind_state.write_pos = start + used;
+
+    // current ^ (current ^ new) = new, and the padding stays zeroed
+    rewind_xor(rewind_state.current, rewind_state.scratch, len);
+    rewind_state.current_size = size;
+}
+
+static void rewind_tick(void)
+{
+    if (!rewind_state.enabled || !app.handlers.saveStateMem || !app.handlers.loadStateMem)
+        return;
+
+    if (!rewind_state.capacity && !rewind_alloc(64 * 1024))
+    {
+        rewind_state.enabled = false;
+        return;
+    }
+
+    if ((rg_input_read_gamepad() & rewind_state.hotkey) == rewind_state.hotkey)
+    {
+        if (!rewind_state.held)
+            rg_audio_set_mute(true);
+        rewind_state.held = true;
+        rg_emu_rewind();
+        return;
+    }
+
+    if (rewind_state.held)
+        rg_audio_set_mute(false);
+    rewind_state.held = false;
+
+    if (++rewind_state.frames >= RG_REWIND_INTERVAL)
+    {
+        rewind_state.frames = 0;
+        rewind_capture();
+    }
+}
+
 void rg_system_tick(int busyTime)
 {
     statistics.lastTick = rg_system_timer();
     statistics.busyTime += busyTime;
     statistics.ticks++;
     // WDT_RELOAD(WDT_TIMEOUT);
+    rg_sram_tick();
+#ifdef RG_ENABLE_BENCHMARK
+    benchmark_tick();
+#else
+    // Dialogs and the virtual keyboard tick with 0 while the emulator is paused, there's no frame to rewind
+    if (busyTime > 0)
+        rewind_tick();
+    if (statistics_updated)
+    {
+        statistics_updated = false;
+        rg_gui_update_status_overlay();
+    }
+    if (pacing.enabled && app.frameTime > 0)
+        tick_pacing();
+#endif
 }
 
 IRAM_ATTR int64_t rg_system_timer(void)
@@ -831,7 +1328,8 @@ IRAM_ATTR int64_t rg_system_timer(void)
 #if defined(ESP_PLATFORM)
     return esp_timer_get_time();
 #elif defined(RG_TARGET_SDL2)
-    return (SDL_GetPerformanceCounter() * 1000000.f) / SDL_GetPerformanceFrequency();
+    // Float isn't precise enough here, the counter is often nanoseconds since boot
+    return (SDL_GetPerformanceCounter() * 1000000.0) / SDL_GetPerformanceFrequency();
 #endif
 }
 
@@ -842,12 +1340,19 @@ void rg_system_event(int event, void *arg)
         app.handlers.event(event, arg);
 }
 
+static void state_writer_wait(void)
+{
+    while (state_writer.completed != state_writer.queued)
+        rg_task_delay(10);
+}
+
 static void shutdown_cleanup(void)
 {
     exitCalled = true;
     rg_display_clear(C_BLACK);                // Let the user know that something is happening
     rg_gui_draw_hourglass();                  // ...
     rg_system_event(RG_EVENT_SHUTDOWN, NULL); // Allow apps to save their state if they want
+    state_writer_wait();                      // Background saves must complete before unmounting
     rg_audio_deinit();                        // Disable sound ASAP to avoid audio garbage
     // rg_system_save_time();                    // RTC might save to storage, do it before
     rg_storage_deinit();                      // Unmount storage
@@ -1213,7 +1718,7 @@ static void emu_update_save_slot(uint8_t slot)
     if (slot != last_written)
     {
         char *filename = rg_emu_get_path(RG_PATH_SAVE_STATE + 0xFF, app.romPath);
-        if (rg_storage_write_file(filename, (void *)&slot, sizeof(slot), 0))
+        if (rg_storage_write_file(filename, (void *)&slot, sizeof(slot), RG_FILE_ATOMIC_WRITE))
             last_written = slot;
         free(filename);
     }
@@ -1231,6 +1736,9 @@ static void emu_update_save_slot(uint8_t slot)
     rg_storage_commit();
 }
 
+#define STATE_CHUNK_EMU   "EMU " // The app's saveStateMem output
+#define STATE_CHUNK_THUMB "THMB" // RAW565 image, see rg_surface_load_image
+
 bool rg_emu_load_state(uint8_t slot)
 {
     if (!app.romPath || !app.handlers.loadState)
@@ -1239,14 +1747,34 @@ bool rg_emu_load_state(uint8_t slot)
         return false;
     }
 
+    // The slot might still be being written
+    state_writer_wait();
+
     char *filename = rg_emu_get_path(RG_PATH_SAVE_STATE + slot, app.romPath);
     bool success = false;
 
     RG_LOGI("Loading state from '%s'.\n", filename);
+    rg_storage_restore_backup(filename);
 
     rg_gui_draw_hourglass();
 
-    if (!(success = (*app.handlers.loadState)(filename)))
+    // States in the container format go through loadStateMem, older ones through the app's file handler
+    rg_state_reader_t *reader = app.handlers.loadStateMem ? rg_state_reader_open(filename) : NULL;
+    if (reader)
+    {
+        void *data = NULL;
+        size_t size = 0;
+        success = rg_state_read_chunk(reader, STATE_CHUNK_EMU, NULL, &data, &size)
+                  && app.handlers.loadStateMem(data, size);
+        rg_state_reader_close(reader);
+        free(data);
+    }
+    else
+    {
+        success = (*app.handlers.loadState)(filename);
+    }
+
+    if (!success)
     {
         RG_LOGE("Load failed!\n");
     }
@@ -1260,66 +1788,221 @@ bool rg_emu_load_state(uint8_t slot)
     return success;
 }
 
-bool rg_emu_save_state(uint8_t slot)
+typedef struct
 {
-    if (!app.romPath || !app.handlers.saveState)
+    char *filename;
+    char *screenshot;
+    rg_surface_t *image; // Captured frame, NULL to use the screenshot handler
+    uint8_t *data;       // Serialized state, NULL to use the saveState handler
+    size_t size;
+    uint8_t slot;
+    rg_emu_save_cb_t callback;
+} save_job_t;
+
+static save_job_t *save_job_create(uint8_t slot, bool serialize)
+{
+    save_job_t *job = calloc(1, sizeof(save_job_t));
+    RG_ASSERT(job, "Out of memory");
+    job->slot = slot;
+    job->filename = rg_emu_get_path(RG_PATH_SAVE_STATE + slot, app.romPath);
+    job->screenshot = rg_emu_get_path(RG_PATH_SCREENSHOT + slot, app.romPath);
+
+    for (size_t capacity = 64 * 1024; serialize && capacity <= MEM_STATE_MAX_SIZE; capacity *= 2)
     {
-        RG_LOGE("No rom or handler defined...\n");
-        return false;
+        if (!(job->data = rg_alloc(capacity, MEM_SLOW | MEM_NOPANIC)))
+            break;
+        job->size = capacity;
+        if (app.handlers.saveStateMem(job->data, &job->size) && job->size <= capacity)
+            break;
+        free(job->data);
+        job->data = NULL;
     }
 
-    char *filename = rg_emu_get_path(RG_PATH_SAVE_STATE + slot, app.romPath);
+    return job;
+}
+
+static void save_job_free(save_job_t *job)
+{
+    rg_surface_free(job->image);
+    free(job->filename);
+    free(job->screenshot);
+    free(job->data);
+    free(job);
+}
+
+// This may run on the storage task, it must not touch the emulator unless data/image are NULL
+static bool save_job_run(save_job_t *job)
+{
     char tempname[RG_PATH_MAX + 8];
     bool success = false;
 
-    RG_LOGI("Saving state to '%s'.\n", filename);
+    RG_LOGI("Saving state to '%s'.\n", job->filename);
 
     rg_system_set_indicator(RG_INDICATOR_ACTIVITY_SYSTEM, 1);
-    rg_gui_draw_hourglass();
+    state_writer.progress = 0;
 
-    if (!rg_storage_mkdir(rg_dirname(filename)))
+    if (!rg_storage_mkdir(rg_dirname(job->filename)))
     {
         RG_LOGE("Unable to create dir, save might fail...\n");
     }
 
-    #define tempname(ext) strcat(strcpy(tempname, filename), ext)
+    #define tempname(ext) strcat(strcpy(tempname, job->filename), ext)
 
-    if ((*app.handlers.saveState)(tempname(".new")))
+    if (job->data)
     {
-        rename(filename, tempname(".bak"));
-
-        if (rename(tempname(".new"), filename) == 0)
+        rg_state_writer_t *writer = rg_state_writer_open(tempname(".new"));
+        success = writer && rg_state_write_chunk(writer, STATE_CHUNK_EMU, 1, job->data, job->size, RG_STATE_COMPRESS);
+        state_writer.progress = 60;
+        if (success && job->image)
         {
-            remove(tempname(".bak"));
-            success = true;
+            // The launcher reads it from there, no need for a separate png
+            size_t size = 4 + job->image->width * job->image->height * 2;
+            uint16_t *thumb = malloc(size);
+            if (thumb)
+            {
+                thumb[0] = job->image->width;
+                thumb[1] = job->image->height;
+                for (int y = 0; y < job->image->height; ++y)
+                    memcpy(thumb + 2 + y * job->image->width,
+                           job->image->data + job->image->offset + y * job->image->stride, job->image->width * 2);
+                rg_state_write_chunk(writer, STATE_CHUNK_THUMB, 1, thumb, size, RG_STATE_COMPRESS);
+                free(thumb);
+            }
         }
+        success = rg_state_writer_close(writer) && success;
+    }
+    else
+    {
+        success = (*app.handlers.saveState)(tempname(".new"));
     }
 
-    if (!success)
+    if (success)
     {
-        RG_LOGE("Save failed!\n");
-        rename(filename, tempname(".bak"));
-        remove(tempname(".new"));
-        rg_gui_alert("Save failed", NULL);
+        success = rg_storage_replace(tempname(".new"), job->filename);
     }
-    else
+
+    if (success)
     {
+        state_writer.progress = 80;
         // Save succeeded, let's take a pretty screenshot for the launcher!
-        char *filename = rg_emu_get_path(RG_PATH_SCREENSHOT + slot, app.romPath);
-        rg_emu_screenshot(filename, rg_display_get_width() / 2, 0);
-        free(filename);
-        emu_update_save_slot(slot);
+        if (job->image && job->data)
+        {
+            remove(job->screenshot); // Stale, the thumbnail is in the state now
+        }
+        else if (job->image)
+        {
+            rg_storage_mkdir(rg_dirname(job->screenshot));
+            rg_surface_save_image_file(job->image, job->screenshot, 0, 0);
+        }
+        else
+        {
+            rg_emu_screenshot(job->screenshot, rg_display_get_width() / 2, 0);
+        }
+    }
+    else
+    {
+        RG_LOGE("Save failed!\n");
+        remove(tempname(".new"));
     }
 
     #undef tempname
-    free(filename);
 
     rg_storage_commit();
     rg_system_set_indicator(RG_INDICATOR_ACTIVITY_SYSTEM, 0);
+    state_writer.progress = 100;
 
     return success;
 }
 
+static bool state_writer_run(void *arg)
+{
+    return save_job_run((save_job_t *)arg);
+}
+
+static void state_writer_done(void *arg, bool success)
+{
+    save_job_t *job = (save_job_t *)arg;
+    // Only point the slot and boot config at the new state once it's on the disk
+    if (success)
+        emu_update_save_slot(job->slot);
+    if (job->callback)
+        job->callback(job->slot, success);
+    else if (!success)
+        state_writer.failed = true;
+    save_job_free(job);
+    state_writer.completed++;
+}
+
+bool rg_emu_save_state(uint8_t slot)
+{
+    if (!app.romPath || !app.handlers.saveState)
+    {
+        RG_LOGE("No rom or handler defined...\n");
+        return false;
+    }
+
+    // Writes to the same file must not be reordered
+    state_writer_wait();
+
+    rg_gui_draw_hourglass();
+
+    // Same as rg_emu_save_state_async, minus the task, so that both produce the same files
+    save_job_t *job = save_job_create(slot, app.handlers.saveStateMem && !app.lowMemoryMode);
+    if (job->data)
+        job->image = rg_display_capture(rg_display_get_width() / 2, 0);
+    bool success = save_job_run(job);
+    save_job_free(job);
+
+    if (success)
+        emu_update_save_slot(slot);
+    else
+        rg_gui_alert("Save failed", NULL);
+
+    return success;
+}
+
+bool rg_emu_save_state_async(uint8_t slot, rg_emu_save_cb_t callback)
+{
+    if (!app.romPath || !app.handlers.saveState)
+    {
+        RG_LOGE("No rom or handler defined...\n");
+        return false;
+    }
+
+    if (!app.handlers.saveStateMem || app.lowMemoryMode)
+        return rg_emu_save_state(slot);
+
+    save_job_t *job = save_job_create(slot, true);
+    job->image = rg_display_capture(rg_display_get_width() / 2, 0);
+    job->callback = callback;
+
+    state_writer.progress = 0;
+    state_writer.queued++;
+
+    if (!job->data || !job->image || !rg_storage_queue(state_writer_run, state_writer_done, job, RG_STORAGE_PRIORITY_NORMAL))
+    {
+        RG_LOGW("Unable to save in the background, falling back to a blocking save.\n");
+        state_writer.queued--;
+        save_job_free(job);
+        return rg_emu_save_state(slot);
+    }
+
+    return true;
+}
+
+int rg_emu_get_save_progress(void)
+{
+    return state_writer.completed != state_writer.queued ? state_writer.progress : -1;
+}
+
+bool rg_emu_save_failed(void)
+{
+    if (!state_writer.failed)
+        return false;
+    state_writer.failed = false;
+    return true;
+}
+
 bool rg_emu_screenshot(const char *filename, int width, int height)
 {
     if (!app.handlers.screenshot)
@@ -1344,6 +2027,19 @@ bool rg_emu_screenshot(const char *filename, int width, int height)
     return success;
 }
 
+rg_image_t *rg_emu_load_state_preview(const char *filename)
+{
+    rg_state_reader_t *reader = rg_state_reader_open(filename);
+    rg_image_t *image = NULL;
+    void *data = NULL;
+    size_t size = 0;
+    if (reader && rg_state_read_chunk(reader, STATE_CHUNK_THUMB, NULL, &data, &size) && size >= 16)
+        image = rg_surface_load_image(data, size, 0);
+    rg_state_reader_close(reader);
+    free(data);
+    return image;
+}
+
 uint8_t rg_emu_get_last_used_slot(const char *romPath)
 {
     uint8_t last_used_slot = 0xFF;
@@ -1357,6 +2053,7 @@ uint8_t rg_emu_get_last_used_slot(const char *romPath)
 
 rg_emu_states_t *rg_emu_get_states(const char *romPath, size_t slots)
 {
+    state_writer_wait();
     rg_emu_states_t *result = calloc(1, sizeof(rg_emu_states_t) + sizeof(rg_emu_slot_t) * slots);
 
     for (size_t i = 0; i < slots; i++)
@@ -1419,6 +2116,110 @@ float rg_emu_get_speed(void)
     return app.speed;
 }
 
+void rg_emu_set_rewind_hotkey(uint32_t keys)
+{
+    rewind_state.hotkey = keys;
+    rewind_state.enabled = keys != 0;
+    rg_settings_set_number(NS_APP, SETTING_REWIND, keys);
+    if (!keys)
+        rewind_free();
+}
+
+uint32_t rg_emu_get_rewind_hotkey(void)
+{
+    return rewind_state.enabled ? rewind_state.hotkey : 0;
+}
+
+bool rg_emu_rewind(void)
+{
+    if (!rewind_state.current_size || !app.handlers.loadStateMem)
+        return false;
+
+    // The first step goes back to the latest snapshot, the following ones undo one delta each.
+    // Once the history is exhausted we stay on the oldest snapshot.
+    if (rewind_state.rewinding && rewind_state.count > 0)
+    {
+        size_t index = (rewind_state.first + --rewind_state.count) % REWIND_MAX_ENTRIES;
+        rewind_apply(rewind_state.ring + rewind_state.entries[index].offset, rewind_state.entries[index].size,
+                     rewind_state.current);
+        rewind_state.current_size = rewind_state.entries[index].prev_size;
+        rewind_state.write_pos = rewind_state.entries[index].offset;
+    }
+
+    rewind_state.rewinding = true;
+    return app.handlers.loadStateMem(rewind_state.current, rewind_state.current_size);
+}
+
+void rg_emu_set_run_ahead(int frames)
+{
+    runahead.frames = RG_MIN(RG_MAX(frames, 0), 2);
+    rg_settings_set_number(NS_APP, SETTING_RUNAHEAD, runahead.frames);
+    if (!runahead.frames)
+    {
+        free(runahead.buffer);
+        runahead.buffer = NULL;
+    }
+}
+
+int rg_emu_get_run_ahead(void)
+{
+    return runahead.supported ? runahead.frames : -1;
+}
+
+void rg_emu_run_frame(void (*run_frame)(bool draw), bool draw)
+{
+    runahead.supported = app.handlers.saveStateMem && app.handlers.loadStateMem;
+
+    if (!runahead.frames || !draw || !app.handlers.saveStateMem || !app.handlers.loadStateMem)
+    {
+        run_frame(draw);
+        return;
+    }
+
+    if (!runahead.buffer)
+    {
+        runahead.capacity = RG_MAX(runahead.capacity, 64 * 1024);
+        runahead.buffer = rg_alloc(runahead.capacity, MEM_SLOW | MEM_NOPANIC);
+        if (!runahead.buffer)
+        {
+            RG_LOGE("Not enough memory for run-ahead!");
+            runahead.frames = 0;
+            run_frame(draw);
+            return;
+        }
+    }
+
+    // The real frame is what we roll back to. Its video and audio are skipped, the last speculative
+    // frame replaces them and this is how the input latency is reduced.
+    rg_audio_set_discard(true);
+    run_frame(false);
+
+    size_t size = runahead.capacity;
+    if (!app.handlers.saveStateMem(runahead.buffer, &size) || size > runahead.capacity)
+    {
+        // Most likely the state didn't fit, try again with a bigger buffer on the next frame
+        free(runahead.buffer);
+        runahead.buffer = NULL;
+        runahead.capacity *= 2;
+        if (runahead.capacity > MEM_STATE_MAX_SIZE)
+        {
+            RG_LOGE("Unable to save state, run-ahead disabled!");
+            runahead.frames = 0;
+        }
+        rg_audio_set_discard(false);
+        return;
+    }
+
+    for (int i = 1; i < runahead.frames; i++)
+        run_frame(false);
+
+    rg_audio_set_discard(false);
+    run_frame(true);
+
+    if (!app.handlers.loadStateMem(runahead.buffer, size))
+        RG_LOGE("Run-ahead state restore failed!");
+}
+
 #ifdef RG_ENABLE_PROFILING
 // Note this profiler might be inaccurate because of:
 // https://gcc.gnu.org/bugzilla/show_bug.cgi?id=28205
@@ -130,6 +130,8 @@ typedef struct
 {
     bool (*loadState)(const char *filename);                         // rg_emu_load_state() handler
     bool (*saveState)(const char *filename);                         // rg_emu_save_state() handler
+    bool (*loadStateMem)(const void *buffer, size_t size);           // Load a state from memory (rewind)
+    bool (*saveStateMem)(void *buffer, size_t *size);                // Save a state to memory, *size is capacity in, used out
     bool (*reset)(bool hard);                                        // rg_emu_reset() handler
     bool (*screenshot)(const char *filename, int width, int height); // rg_emu_screenshot() handler
     void (*event)(int event, void *data);                            // listen to retro-go system events
@@ -207,6 +209,11 @@ typedef struct
     int freeBlockInt;
     int freeBlockExt;
     int freeStackMain;
+    int audioUnderruns;  // Since boot
+    int audioOverruns;   // Since boot
+    int audioQueueDepth; // Percent of the audio buffer in use
+    int audioLatency;    // Microseconds
+    int audioSubmitTime; // Average time spent in the driver per submit, in microseconds
 } rg_stats_t;
 
 rg_app_t *rg_system_init(int sampleRate, const rg_handlers_t *handlers, void *_unused);
@@ -224,10 +231,14 @@ void rg_system_set_indicator_mask(rg_indicator_t indicator, bool on);
 bool rg_system_get_indicator_mask(rg_indicator_t indicator);
 void rg_system_set_tick_rate(int tickRate);
 int rg_system_get_tick_rate(void);
+// When enabled rg_system_tick paces the caller to the tick rate, kept in sync with the audio device.
+// Otherwise only a full audio buffer will slow down the app.
+void rg_system_set_tick_pacing(bool enable);
 void rg_system_set_overclock(int level);
 int  rg_system_get_overclock(void);
 void rg_system_set_log_level(rg_log_level_t level);
 int  rg_system_get_log_level(void);
+// Called once per emulated frame with the time spent on it. UI loops that don't run the emulator pass 0.
 void rg_system_tick(int busyTime);
 void rg_system_vlog(int level, const char *context, const char *format, va_list va);
 void rg_system_log(int level, const char *context, const char *format, ...) __attribute__((format(printf,3,4)));
@@ -258,9 +269,10 @@ typedef struct
 rg_task_t *rg_task_create(const char *name, void (*taskFunc)(void *arg), void *arg, size_t stackSize, int priority, int affinity);
 rg_task_t *rg_task_find(const char *name);
 rg_task_t *rg_task_current(void);
-bool rg_task_send(rg_task_t *task, const rg_task_msg_t *msg);
-bool rg_task_peek(rg_task_msg_t *out);
-bool rg_task_receive(rg_task_msg_t *out);
+// Every task has a queue of RG_TASK_QUEUE_LENGTH messages. timeoutMS < 0 waits forever.
+bool rg_task_send(rg_task_t *task, const rg_task_msg_t *msg, int timeoutMS);
+bool rg_task_peek(rg_task_msg_t *out, int timeoutMS);
+bool rg_task_receive(rg_task_msg_t *out, int timeoutMS);
 bool rg_task_is_blocked(rg_task_t *task);
 size_t rg_task_messages_waiting(rg_task_t *task);
 // The main difference between rg_task_delay and rg_usleep is that rg_task_delay will yield
@@ -277,13 +289,35 @@ bool rg_mutex_take(rg_mutex_t *mutex, int timeoutMS);
 
 char *rg_emu_get_path(rg_path_type_t type, const char *arg);
 bool rg_emu_save_state(uint8_t slot);
+// Called from the state writer task when a background save completes
+typedef void (*rg_emu_save_cb_t)(uint8_t slot, bool success);
+// The state is serialized right away, the files are written by a low priority task. It falls back to
+// rg_emu_save_state if the app has no saveStateMem handler or memory is short. callback may be NULL.
+bool rg_emu_save_state_async(uint8_t slot, rg_emu_save_cb_t callback);
+// Returns the progress (0-100) of the background save in progress, or -1 if none
+int rg_emu_get_save_progress(void);
+// Returns true once if a background save without a callback failed since the last call
+bool rg_emu_save_failed(void);
 bool rg_emu_load_state(uint8_t slot);
 bool rg_emu_reset(bool hard);
 bool rg_emu_screenshot(const char *filename, int width, int height);
+// Returns the thumbnail embedded in a save state, NULL if there's none (older states have a separate png)
+rg_image_t *rg_emu_load_state_preview(const char *filename);
 rg_emu_states_t *rg_emu_get_states(const char *romPath, size_t slots);
 uint8_t rg_emu_get_last_used_slot(const char *romPath);
 void rg_emu_set_speed(float speed);
 float rg_emu_get_speed(void);
+// Rewind runs while the hotkey (a combination of rg_key_t) is held, 0 disables it
+void rg_emu_set_rewind_hotkey(uint32_t keys);
+uint32_t rg_emu_get_rewind_hotkey(void);
+bool rg_emu_rewind(void);
+void rg_emu_set_run_ahead(int frames);
+// Returns -1 if the app doesn't support run-ahead (it doesn't use rg_emu_run_frame or has no memory state handlers)
+int rg_emu_get_run_ahead(void);
+// Runs one frame with run_frame(draw). With run-ahead enabled (and draw set), that frame is emulated without
+// output and then rg_emu_get_run_ahead() more frames are emulated, the last one being presented, before the
+// state is rolled back. Only the audio of that last frame is submitted.
+void rg_emu_run_frame(void (*run_frame)(bool draw), bool draw);
 
 /* Utilities */
 
@@ -311,6 +345,11 @@ float rg_emu_get_speed(void);
 #define RG_LOGV(x, ...) rg_system_log(RG_LOG_VERBOSE, RG_LOG_TAG, x, ## __VA_ARGS__)
 #endif
 
+#ifdef RG_ENABLE_BENCHMARK
+// Feeds the checksums written by the frame-hash runner (tools/framehash_sdl2.sh)
+void rg_system_benchmark_hash(bool audio, uint32_t crc);
+#endif
+
 #ifdef RG_ENABLE_PROFILING
 void __cyg_profile_func_enter(void *this_fn, void *call_site);
 void __cyg_profile_func_exit(void *this_fn, void *call_site);
@@ -466,6 +466,18 @@ static const char *translations[][RG_LANG_MAX] =
         [RG_LANG_EN] = "Speed",
         [RG_LANG_FR] = "Vitesse",
     },
+    {
+        [RG_LANG_EN] = "Rewind",
+        [RG_LANG_FR] = "Rembobinage",
+    },
+    {
+        [RG_LANG_EN] = "Run-ahead",
+        [RG_LANG_FR] = "Anticipation",
+    },
+    {
+        [RG_LANG_EN] = "Status overlay",
+        [RG_LANG_FR] = "Affichage du statut",
+    },
 
     // about menu
     {
@@ -703,6 +715,10 @@ static const char *translations[][RG_LANG_MAX] =
         [RG_LANG_EN] = "Scanning %s %d/%d",
         [RG_LANG_FR] = "Scan %s %d/%d",
     },
+    {
+        [RG_LANG_EN] = "Preparing game...",
+        [RG_LANG_FR] = "Préparation du jeu...",
+    },
     // message when no rom
     {
         [RG_LANG_EN] = "Welcome to Retro-Go!",
@@ -15,6 +15,7 @@ static int64_t KeyboardDebounce = 0;
 static int FrameStartTime;
 static int KeyboardEmulation, CropPicture;
 static char *PendingLoadSTA = NULL;
+static int PendingResumeSlot = -1;
 
 #define BPS16
 #define BPP16
@@ -36,6 +37,9 @@ static uint16_t *XBuf;
 
 #include <fmsx.h>
 
+// msxfix.h renames fMSX's main() but on SDL2 app_main() must remain the real main()
+#undef main
+
 static Image NormScreen;
 const char *Title = "fMSX 6.0";
 const char *Disks[2][MAXDISKS + 1];
@@ -262,6 +266,13 @@ void Keyboard(void)
     rg_system_tick(rg_system_timer() - FrameStartTime);
     FrameStartTime = rg_system_timer();
 
+    // States can only be loaded once the MSX is running
+    if (PendingResumeSlot >= 0)
+    {
+        rg_emu_load_state(PendingResumeSlot);
+        PendingResumeSlot = -1;
+    }
+
     if (PendingLoadSTA)
     {
         LoadSTA(PendingLoadSTA);
@@ -336,7 +347,7 @@ void PlayAllSound(int uSec)
 {
     int64_t start = rg_system_timer();
     unsigned int samples = 2 * uSec * AUDIO_SAMPLE_RATE / 1000000;
-    rg_task_send(audioQueue, &(rg_task_msg_t){.dataInt = samples});
+    rg_task_send(audioQueue, &(rg_task_msg_t){.dataInt = samples}, -1);
     FrameStartTime += rg_system_timer() - start;
 }
 
@@ -357,6 +368,45 @@ static bool load_state_handler(const char *filename)
     return true;
 }
 
+word StateID(void); // MSX.c
+
+static int get_state_id(void)
+{
+    // StateID() sums up all the ROMs, they don't change once started so it's only done once
+    static int state_id = -1;
+    if (state_id < 0)
+        state_id = StateID();
+    return state_id;
+}
+
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    // EMULib serializes to memory natively, the header makes it the same as a .STA file (see SaveSTA)
+    uint8_t *header = buffer;
+    if (*size <= 16)
+        return false;
+    int id = get_state_id();
+    memcpy(header, "STE\032\003\0\0\0\0\0\0\0\0\0\0\0", 16);
+    header[5] = RAMPages;
+    header[6] = VRAMPages;
+    header[7] = id & 0xFF;
+    header[8] = id >> 8;
+    size_t length = SaveState(header + 16, *size - 16);
+    *size = length + 16;
+    return length > 0;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    const uint8_t *header = buffer;
+    if (size > 16 && memcmp(header, "STE\032\003", 5) == 0 && header[7] + header[8] * 256 == get_state_id()
+        && header[5] == (RAMPages & 0xFF) && header[6] == (VRAMPages & 0xFF)
+        && LoadState((unsigned char *)header + 16, size - 16))
+        return true;
+    ResetMSX(Mode, RAMPages, VRAMPages);
+    return false;
+}
+
 static bool reset_handler(bool hard)
 {
     ResetMSX(Mode,RAMPages,VRAMPages);
@@ -403,10 +453,10 @@ static void audioTask(void *arg)
 {
     RG_LOGI("task started");
     rg_task_msg_t msg;
-    while (rg_task_peek(&msg))
+    while (rg_task_peek(&msg, -1))
     {
         RenderAndPlayAudio(msg.dataInt);
-        rg_task_receive(&msg);
+        rg_task_receive(&msg, -1);
     }
 }
 
@@ -422,6 +472,8 @@ void app_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
@@ -454,10 +506,10 @@ void app_main(void)
 
     if (app->bootFlags & RG_BOOT_RESUME)
     {
-        PendingLoadSTA = rg_emu_get_path(RG_PATH_SAVE_STATE + app->saveSlot, app->romPath);
+        PendingResumeSlot = app->saveSlot;
     }
 
-    const char *argv[] = {
+    const char *args[] = {
         "fmsx",
         "-ram", "2",
         "-vram", "2",
@@ -466,18 +518,18 @@ void app_main(void)
         "-joy", "1",
         NULL, NULL, NULL,
     };
-    int argc = RG_COUNT(argv) - 3;
+    int nargs = RG_COUNT(args) - 3;
 
     if (rg_extension_match(app->romPath, "dsk"))
     {
-        argv[argc++] = "-diska";
+        args[nargs++] = "-diska";
     }
-    argv[argc++] = app->romPath;
+    args[nargs++] = app->romPath;
 
     audioQueue = rg_task_create("audioTask", &audioTask, NULL, 4096, RG_TASK_PRIORITY_2, 1);
 
     RG_LOGI("fMSX start");
-    fmsx_main(argc, (char **)argv);
+    fmsx_main(nargs, (char **)args);
 
     RG_LOGI("fMSX ended");
     rg_system_exit();
@@ -30,6 +30,10 @@ static rg_surface_t *updates[2];
 static rg_surface_t *currentUpdate;
 static rg_app_t *app;
 
+static rg_audio_mixer_t *mixer;
+static int ym2612_source;
+static int sn76489_source;
+
 static const char *SETTING_YFM_EMULATION = "yfm_enable";
 static const char *SETTING_Z80_EMULATION = "z80_enable";
 static const char *SETTING_SN76489_EMULATION = "sn_enable";
@@ -84,7 +88,7 @@ void saveGwenesisStateGetBuffer(SaveState* state, const char* tagName, void* buf
         if (strncmp(var.key, tagName, sizeof(var.key)) == 0)
         {
             fread(buffer, RG_MIN(var.length, length), 1, savestate_fp);
-            RG_LOGI("Loaded key '%s'\n", tagName);
+            RG_LOGD("Loaded key '%s'\n", tagName);
             return;
         }
         fseek(savestate_fp, var.length, SEEK_CUR);
@@ -100,7 +104,7 @@ void saveGwenesisStateSetBuffer(SaveState* state, const char* tagName, void* buf
     strncpy(var.key, tagName, sizeof(var.key) - 1);
     fwrite(&var, sizeof(var), 1, savestate_fp);
     fwrite(buffer, length, 1, savestate_fp);
-    RG_LOGI("Saved key '%s'\n", tagName);
+    RG_LOGD("Saved key '%s'\n", tagName);
 }
 
 void gwenesis_io_get_buttons()
@@ -175,6 +179,34 @@ static bool load_state_handler(const char *filename)
     return false;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    if ((savestate_fp = rg_storage_memopen(buffer, *size, "wb")))
+    {
+        savestate_errors = 0;
+        gwenesis_save_state();
+        bool success = savestate_errors == 0 && fseek(savestate_fp, 0, SEEK_END) == 0 && !ferror(savestate_fp);
+        *size = ftell(savestate_fp);
+        fclose(savestate_fp);
+        return success;
+    }
+    return false;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    if ((savestate_fp = rg_storage_memopen((void *)buffer, size, "rb")))
+    {
+        savestate_errors = 0;
+        gwenesis_load_state();
+        fclose(savestate_fp);
+        if (savestate_errors == 0)
+            return true;
+    }
+    reset_emulation();
+    return false;
+}
+
 static bool reset_handler(bool hard)
 {
     reset_emulation();
@@ -202,6 +234,8 @@ void app_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
@@ -214,6 +248,11 @@ void app_main(void)
     sn76489_enabled = rg_settings_get_number(NS_APP, SETTING_SN76489_EMULATION, 0);
     z80_enabled = rg_settings_get_number(NS_APP, SETTING_Z80_EMULATION, 1);
 
+    // Both chips run at AUDIO_SAMPLE_RATE, the mixer halves it to keep the audio task's load reasonable
+    mixer = rg_audio_mixer_create(AUDIO_SAMPLE_RATE / 2, 2);
+    ym2612_source = rg_audio_mixer_add_source(mixer, RG_AUDIO_SOURCE_MONO, AUDIO_SAMPLE_RATE, 1.f);
+    sn76489_source = rg_audio_mixer_add_source(mixer, RG_AUDIO_SOURCE_MONO, AUDIO_SAMPLE_RATE, 1.f);
+
     updates[0] = rg_surface_create(320, 241, RG_PIXEL_PAL565_BE, MEM_FAST);
     // updates[1] = rg_surface_create(320, 241, RG_PIXEL_PAL565_BE, MEM_FAST);
     currentUpdate = updates[0];
@@ -233,7 +272,7 @@ void app_main(void)
 
     if (rg_extension_match(app->romPath, "zip"))
     {
-        if (!rg_storage_unzip_file(app->romPath, NULL, &rom_data, &rom_size, RG_FILE_ALIGN_64KB))
+        if (!rg_storage_unzip_file(app->romPath, "md gen bin", &rom_data, &rom_size, RG_FILE_ALIGN_64KB))
             RG_PANIC("ROM file unzipping failed!");
     }
     else if (!rg_storage_read_file(app->romPath, &rom_data, &rom_size, RG_FILE_ALIGN_64KB))
@@ -257,6 +296,7 @@ void app_main(void)
     }
 
     rg_system_set_tick_rate(60);
+    rg_system_set_tick_pacing(true);
     app->frameskip = 3;
 
     extern unsigned char gwenesis_vdp_regs[0x20];
@@ -398,10 +438,10 @@ void app_main(void)
 
         rg_system_tick(rg_system_timer() - startTime);
 
-        if (yfm_enabled || z80_enabled) {
-            // TODO: Mix in gwenesis_sn76489_buffer
-            rg_audio_submit((void *)gwenesis_ym2612_buffer, AUDIO_BUFFER_LENGTH >> 1);
-        }
+        // A disabled chip doesn't produce any sample so it costs nothing to the mixer
+        rg_audio_mixer_write(mixer, ym2612_source, gwenesis_ym2612_buffer, ym2612_index);
+        rg_audio_mixer_write(mixer, sn76489_source, gwenesis_sn76489_buffer, sn76489_index);
+        rg_audio_mixer_submit(mixer, RG_MAX(ym2612_index, sn76489_index) / 2);
 
         if (skipFrames == 0)
         {
@@ -135,6 +135,11 @@ static void application_start(retro_file_t *file, int load_state)
         flags |= RG_BOOT_RESUME;
         flags |= (load_state << 4) & RG_BOOT_SLOT_MASK;
     }
+    if (file->app->use_rom_cache)
+    {
+        rg_gui_draw_message(_("Preparing game..."));
+        rg_storage_cache_rom(path, file->app->extensions, file->checksum);
+    }
     bookmark_add(BOOK_TYPE_RECENT, file); // This could relocate *file, but we no longer need it
     rg_system_switch_app(part, name, path, flags);
 }
@@ -202,7 +207,7 @@ static void crc_cache_save(void)
 
     RG_LOGI("Saving CRC cache...");
     size_t data_len = RG_MIN(8 + (crc_cache->count * sizeof(crc_cache->entries[0])), sizeof(*crc_cache));
-    crc_cache_dirty = !rg_storage_write_file(RG_BASE_PATH_CACHE"/crc32.bin", crc_cache, data_len, 0);
+    crc_cache_dirty = !rg_storage_write_file(RG_BASE_PATH_CACHE"/crc32.bin", crc_cache, data_len, RG_FILE_ATOMIC_WRITE);
 }
 
 static uint32_t crc_cache_calc_key(retro_file_t *file)
@@ -675,6 +680,8 @@ static void application(const char *desc, const char *name, const char *exts, co
     app->files = calloc(100, sizeof(retro_file_t));
     app->files_capacity = 100;
     app->crc_offset = crc_offset;
+    // These cores can run from a ROM mapped from flash, see rg_storage_cache_rom
+    app->use_rom_cache = strcmp(name, "nes") == 0 || strcmp(name, "gb") == 0 || strcmp(name, "gbc") == 0;
 
     gui_add_tab(app->short_name, app->description, app, event_handler);
 }
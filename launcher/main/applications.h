@@ -41,6 +41,7 @@ typedef struct retro_app_s
     size_t files_capacity;
     size_t files_count;
     bool use_crc_covers;
+    bool use_rom_cache;
     bool initialized;
     bool available;
 } retro_app_t;
@@ -21,6 +21,16 @@ retro_gui_t gui;
 #define SETTING_SCROLL_MODE     "ScrollMode"
 #define SETTING_HIDE_TAB(name)  strcat((char[99]){"HideTab."}, (name))
 
+// Raw cover files read ahead for the items around the cursor, so that scrolling doesn't wait on the SD card
+#define COVER_CACHE_SIZE    4
+static struct {
+    char *path;
+    void *data;
+    size_t data_len;
+} cover_cache[COVER_CACHE_SIZE];
+static rg_mutex_t *cover_cache_lock;
+static int cover_cache_next;
+
 static int max_visible_lines(const tab_t *tab, int *_line_height)
 {
     int line_height = TEXT_RECT("ABC123", 0).height;
@@ -46,6 +56,8 @@ void gui_init(bool cold_boot)
     gui.theme = &gui.themes[gui.color_theme % RG_COUNT(gui.themes)];
     gui.http_lock = false;
     gui.low_memory_mode = rg_system_get_app()->lowMemoryMode;
+    if (!gui.low_memory_mode && !cover_cache_lock)
+        cover_cache_lock = rg_mutex_create();
     gui.surface = rg_surface_create(gui.width, gui.height, RG_PIXEL_565_LE, MEM_SLOW);
     gui_update_theme();
 }
@@ -543,6 +555,103 @@ void gui_set_preview(tab_t *tab, rg_image_t *preview)
     tab->preview = preview;
 }
 
+// Called from the storage task
+static void cover_cache_store(void *arg, const char *path, void *data, size_t data_len)
+{
+    if (!data)
+        return;
+    rg_mutex_take(cover_cache_lock, -1);
+    int index = cover_cache_next++ % COVER_CACHE_SIZE;
+    free(cover_cache[index].path);
+    free(cover_cache[index].data);
+    cover_cache[index].path = strdup(path);
+    cover_cache[index].data = data;
+    cover_cache[index].data_len = data_len;
+    rg_mutex_give(cover_cache_lock);
+}
+
+static rg_image_t *cover_cache_load(const char *path)
+{
+    void *data = NULL;
+    size_t data_len = 0;
+
+    if (cover_cache_lock)
+    {
+        rg_mutex_take(cover_cache_lock, -1);
+        for (int i = 0; i < COVER_CACHE_SIZE; ++i)
+        {
+            if (cover_cache[i].path && strcmp(cover_cache[i].path, path) == 0)
+            {
+                data = cover_cache[i].data;
+                data_len = cover_cache[i].data_len;
+                free(cover_cache[i].path);
+                cover_cache[i].path = NULL;
+                cover_cache[i].data = NULL;
+                break;
+            }
+        }
+        rg_mutex_give(cover_cache_lock);
+    }
+
+    if (!data)
+        return rg_surface_load_image_file(path, 0);
+
+    rg_image_t *image = rg_surface_load_image(data, data_len, 0);
+    free(data);
+    return image;
+}
+
+static size_t get_cover_path(retro_file_t *file, int type, char *path, bool allow_crc)
+{
+    retro_app_t *app = file->app;
+    size_t path_len = 0;
+
+    // Computing a checksum means reading the whole ROM, only do it when asked to
+    bool have_crc = app->use_crc_covers && (file->checksum || (allow_crc && application_get_file_crc32(file)));
+
+    if (type == 0x1 && have_crc) // Game cover (old format)
+        path_len = snprintf(path, RG_PATH_MAX, "%s/%X/%08X.art", app->paths.covers, (int)(file->checksum >> 28), (int)file->checksum);
+    else if (type == 0x2 && have_crc) // Game cover (png)
+        path_len = snprintf(path, RG_PATH_MAX, "%s/%X/%08X.png", app->paths.covers, (int)(file->checksum >> 28), (int)file->checksum);
+    else if (type == 0x3) // Game cover (based on filename)
+    {
+        path_len = snprintf(path, RG_PATH_MAX, "%s/%s", app->paths.covers, file->name);
+        if (path_len < RG_PATH_MAX - 3) // Don't bother if we already have an overflow
+            strcpy(path + path_len - strlen(rg_extension(file->name) ?: ""), "png");
+    }
+
+    return path_len;
+}
+
+static void cover_prefetch(tab_t *tab, uint32_t order)
+{
+    // Stale requests would only push the covers we actually want further down the queue
+    rg_storage_cancel(&cover_cache);
+
+    for (int offset = 1; offset >= -1; offset -= 2)
+    {
+        int index = tab->listbox.cursor + offset;
+        if (index < 0 || index >= tab->listbox.length || !tab->listbox.items[index].arg)
+            continue;
+
+        retro_file_t *file = tab->listbox.items[index].arg;
+        char path[RG_PATH_MAX + 1];
+
+        for (uint32_t types = order; types; types >>= 4)
+        {
+            int type = types & 0xF;
+            if (type < 0x1 || type > 0x3 || (file->missing_cover & (1 << type)))
+                continue;
+            size_t path_len = get_cover_path(file, type, path, false);
+            if (path_len > 0 && path_len < RG_PATH_MAX)
+            {
+                rg_storage_read_file_async(path, 0, RG_STORAGE_PRIORITY_LOW, cover_cache_store, &cover_cache);
+                break;
+            }
+        }
+    }
+}
+
 void gui_load_preview(tab_t *tab)
 {
     listbox_item_t *item = gui_get_selected_item(tab);
@@ -578,7 +687,7 @@ void gui_load_preview(tab_t *tab)
     }
 
     retro_file_t *file = item->arg;
-    retro_app_t *app = file->app;
+    uint32_t order_all = order;
     uint32_t errors = 0;
 
     while (order && !tab->preview)
@@ -596,24 +705,21 @@ void gui_load_preview(tab_t *tab)
         if (file->missing_cover & (1 << type))
             continue;
 
-        if (type == 0x1 && app->use_crc_covers && application_get_file_crc32(file)) // Game cover (old format)
-            path_len = snprintf(path, RG_PATH_MAX, "%s/%X/%08X.art", app->paths.covers, (int)(file->checksum >> 28), (int)file->checksum);
-        else if (type == 0x2 && app->use_crc_covers && application_get_file_crc32(file)) // Game cover (png)
-            path_len = snprintf(path, RG_PATH_MAX, "%s/%X/%08X.png", app->paths.covers, (int)(file->checksum >> 28), (int)file->checksum);
-        else if (type == 0x3) // Game cover (based on filename)
-        {
-            path_len = snprintf(path, RG_PATH_MAX, "%s/%s", app->paths.covers, file->name);
-            if (path_len < RG_PATH_MAX - 3) // Don't bother if we already have an overflow
-                strcpy(path + path_len - strlen(rg_extension(file->name) ?: ""), "png");
-        }
+        if (type >= 0x1 && type <= 0x3)
+            path_len = get_cover_path(file, type, path, true);
         else if (type == 0x4 && file->saves > 0) // Save state screenshot (png)
         {
             snprintf(path, RG_PATH_MAX, "%s/%s", file->folder, file->name);
             uint8_t last_used_slot = rg_emu_get_last_used_slot(path);
             if (last_used_slot != 0xFF)
             {
+                char *state = rg_emu_get_path(RG_PATH_SAVE_STATE + last_used_slot, path);
                 char *preview = rg_emu_get_path(RG_PATH_SCREENSHOT + last_used_slot, path);
-                path_len = snprintf(path, RG_PATH_MAX, "%s", preview);
+                // Newer states embed their thumbnail, older ones have a png next to them
+                gui_set_preview(tab, rg_emu_load_state_preview(state));
+                if (!tab->preview)
+                    path_len = snprintf(path, RG_PATH_MAX, "%s", preview);
+                free(state);
                 free(preview);
             }
         }
@@ -621,7 +727,7 @@ void gui_load_preview(tab_t *tab)
         if (path_len > 0 && path_len < RG_PATH_MAX)
         {
             RG_LOGD("Looking for %s", path);
-            gui_set_preview(tab, rg_surface_load_image_file(path, 0));
+            gui_set_preview(tab, cover_cache_load(path));
             // if (!tab->preview && rg_storage_exists(path))
             //     errors++;
         }
@@ -636,4 +742,6 @@ void gui_load_preview(tab_t *tab)
         // gui_draw_status(tab);
         // tab->preview = gui_get_image("cover", file->app);
     }
+
+    cover_prefetch(tab, order_all);
 }
@@ -554,7 +554,7 @@ bool D_AddFile(const char *file)
 #ifdef RETRO_GO
   // I'd prefer to do this in retro-go's prboom's main.c, but this is easier for now...
   if (rg_extension_match(file, "zip")) {
-    if (rg_storage_unzip_file(file, NULL, (void **)&wadfile.data, &wadfile.size, 0)) {
+    if (rg_storage_unzip_file(file, "wad", (void **)&wadfile.data, &wadfile.size, 0)) {
       char *name = (char *)wadfile.name;
       size_t len = strlen(name);
       name[len - 1] = 'd';
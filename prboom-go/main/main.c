@@ -15,8 +15,8 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <sys/dirent.h>
-#include <sys/unistd.h>
+#include <dirent.h>
+#include <unistd.h>
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <string.h>
@@ -70,14 +70,15 @@ typedef struct {
 
 typedef struct {
     const doom_sfx_t *sfx;
-    size_t pos;
-    float factor;
     int starttic;
+    int source;
 } channel_t;
 
 static channel_t channels[NUM_MIX_CHANNELS];
 static const doom_sfx_t *sfx[NUMSFX];
 static rg_audio_sample_t mixbuffer[AUDIO_BUFFER_LENGTH];
+static rg_audio_mixer_t *mixer;
+static int music_source;
 static const music_player_t *music_player = &opl_synth_player;
 static bool musicPlaying = false;
 
@@ -184,6 +185,10 @@ void I_InitGraphics(void)
 
 int I_GetTimeMS(void)
 {
+#ifdef RG_ENABLE_BENCHMARK
+    // Benchmark runs are unpaced and must be reproducible: exactly one tic per I_StartTic (+1 for rounding)
+    return (int64_t)rg_system_get_counters().ticks * 1000 / TICRATE + 1;
+#endif
     return rg_system_timer() / 1000;
 }
 
@@ -227,14 +232,14 @@ int I_StartSound(int sfxid, int channel, int vol, int sep, int pitch, int priori
         for (int i = 0; i < NUM_MIX_CHANNELS; i++)
         {
             if (channels[i].sfx == sfx[sfxid])
-                channels[i].sfx = NULL;
+                I_StopSound(i);
         }
     }
 
     // Find available channel or steal the oldest
     for (int i = 0; i < NUM_MIX_CHANNELS; i++)
     {
-        if (channels[i].sfx == NULL)
+        if (!rg_audio_mixer_is_playing(mixer, channels[i].source))
         {
             slot = i;
             break;
@@ -248,8 +253,10 @@ int I_StartSound(int sfxid, int channel, int vol, int sep, int pitch, int priori
 
     channel_t *chan = &channels[slot];
     chan->sfx = sfx[sfxid];
-    chan->factor = (float)chan->sfx->samplerate / snd_samplerate;
-    chan->pos = 0;
+    chan->starttic = gametic;
+    rg_audio_mixer_set_rate(mixer, chan->source, chan->sfx->samplerate);
+    rg_audio_mixer_set_gain(mixer, chan->source, snd_SfxVolume ? 0.5f / (16 - snd_SfxVolume) : 0.f);
+    rg_audio_mixer_write(mixer, chan->source, chan->sfx->samples, chan->sfx->length);
 
     return slot;
 }
@@ -257,7 +264,10 @@ int I_StartSound(int sfxid, int channel, int vol, int sep, int pitch, int priori
 void I_StopSound(int handle)
 {
     if (handle < NUM_MIX_CHANNELS)
+    {
         channels[handle].sfx = NULL;
+        rg_audio_mixer_write(mixer, channels[handle].source, NULL, 0);
+    }
 }
 
 bool I_SoundIsPlaying(int handle)
@@ -269,7 +279,7 @@ bool I_SoundIsPlaying(int handle)
 bool I_AnySoundStillPlaying(void)
 {
     for (int i = 0; i < NUM_MIX_CHANNELS; i++)
-        if (channels[i].sfx)
+        if (rg_audio_mixer_is_playing(mixer, channels[i].source))
             return true;
     return false;
 }
@@ -278,71 +288,14 @@ static void soundTask(void *arg)
 {
     while (1)
     {
-        bool haveMusic = snd_MusicVolume > 0 && musicPlaying;
-        bool haveSFX = snd_SfxVolume > 0 && I_AnySoundStillPlaying();
-
-        if (haveMusic)
+        if (snd_MusicVolume > 0 && musicPlaying)
         {
             music_player->render(mixbuffer, AUDIO_BUFFER_LENGTH);
+            rg_audio_mixer_write(mixer, music_source, mixbuffer, AUDIO_BUFFER_LENGTH);
         }
 
-        if (haveSFX)
-        {
-            int16_t *audioBuffer = (int16_t *)mixbuffer;
-            int16_t *audioBufferEnd = audioBuffer + AUDIO_BUFFER_LENGTH * 2;
-            while (audioBuffer < audioBufferEnd)
-            {
-                int totalSample = 0;
-                int totalSources = 0;
-                int sample;
-
-                for (int i = 0; i < NUM_MIX_CHANNELS; i++)
-                {
-                    channel_t *chan = &channels[i];
-                    if (!chan->sfx)
-                        continue;
-
-                    size_t pos = (size_t)(chan->pos++ * chan->factor);
-
-                    if (pos >= chan->sfx->length)
-                    {
-                        chan->sfx = NULL;
-                    }
-                    else if ((sample = chan->sfx->samples[pos]))
-                    {
-                        totalSample += sample - 127;
-                        totalSources++;
-                    }
-                }
-
-                totalSample <<= 7;
-                totalSample /= (16 - snd_SfxVolume);
-
-                if (haveMusic)
-                {
-                    totalSample += *audioBuffer;
-                    totalSources += (totalSources == 0);
-                }
-
-                if (totalSources > 0)
-                    totalSample /= totalSources;
-
-                if (totalSample > 32767)
-                    totalSample = 32767;
-                else if (totalSample < -32768)
-                    totalSample = -32768;
-
-                *audioBuffer++ = totalSample;
-                *audioBuffer++ = totalSample;
-            }
-        }
-
-        if (!haveMusic && !haveSFX)
-        {
-            memset(mixbuffer, 0, sizeof(mixbuffer));
-        }
-
-        rg_audio_submit(mixbuffer, AUDIO_BUFFER_LENGTH);
+        // The sound effects are 8bit samples at their own rate, the mixer takes care of them
+        rg_audio_mixer_submit(mixer, AUDIO_BUFFER_LENGTH);
     }
 }
 
@@ -354,6 +307,11 @@ void I_InitSound(void)
             sfx[i] = W_CacheLumpNum(S_sfx[i].lumpnum);
     }
 
+    mixer = rg_audio_mixer_create(snd_samplerate, NUM_MIX_CHANNELS + 1);
+    for (int i = 0; i < NUM_MIX_CHANNELS; i++)
+        channels[i].source = rg_audio_mixer_add_source(mixer, RG_AUDIO_SOURCE_U8, snd_samplerate, 1.f);
+    music_source = rg_audio_mixer_add_source(mixer, RG_AUDIO_SOURCE_STEREO, snd_samplerate, 1.f);
+
     music_player->init(snd_samplerate);
     music_player->setvolume(snd_MusicVolume);
 
@@ -518,7 +476,7 @@ bool is_iwad(const char *path)
     void *data = &header;
     size_t data_len = 16;
     if (rg_extension_match(path, "zip"))
-        rg_storage_unzip_file(path, NULL, &data, &data_len, RG_FILE_USER_BUFFER);
+        rg_storage_unzip_file(path, "wad", &data, &data_len, RG_FILE_USER_BUFFER);
     else
         rg_storage_read_file(path, &data, &data_len, RG_FILE_USER_BUFFER);
     return header[0] == 'I' && header[1] == 'W';
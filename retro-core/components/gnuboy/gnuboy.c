@@ -174,37 +174,35 @@ int gnuboy_load_bios_file(const char *file)
 }
 
 
-void gnuboy_load_bank(int bank)
+static void sync_banks(void)
 {
-	const size_t OFFSET = bank * BANK_SIZE;
+	// The stream may have evicted pages to make room, its page table is the authority
+	for (int i = 0; i < cart.romsize; i++)
+		cart.rombanks[i] = cart.romStream->pages[i % cart.romStream->page_count];
+}
 
-	if (!cart.rombanks[bank])
-		cart.rombanks[bank] = malloc(BANK_SIZE);
 
-	if (!cart.romFile)
+void gnuboy_load_bank(int bank)
+{
+	if (!cart.romStream)
+	{
+		if (!cart.rombanks[bank])
+			cart.rombanks[bank] = malloc(BANK_SIZE);
 		return;
+	}
 
 	MESSAGE_INFO("loading bank %d.\n", bank);
-	while (!cart.rombanks[bank])
-	{
-		int i = rand() & 0xFF;
-		if (cart.rombanks[i])
-		{
-			MESSAGE_INFO("reclaiming bank %d.\n", i);
-			cart.rombanks[bank] = cart.rombanks[i];
-			cart.rombanks[i] = NULL;
-			break;
-		}
-	}
 
-	// Load the 16K page
-	if (fseek(cart.romFile, OFFSET, SEEK_SET) != 0
-		|| !fread(cart.rombanks[bank], BANK_SIZE, 1, cart.romFile))
+	// Bank 0 is always mapped, it must never be the one evicted
+	rg_stream_touch(cart.romStream, 0);
+
+	if (!rg_stream_get_page(cart.romStream, bank % cart.romStream->page_count))
 	{
-		MESSAGE_WARN("ROM bank loading failed\n");
-		if (!feof(cart.romFile))
-			abort(); // This indicates an SD Card failure
+		MESSAGE_ERROR("ROM bank loading failed\n");
+		abort(); // This indicates an SD Card failure
 	}
+
+	sync_banks();
 }
 
 
@@ -411,18 +409,19 @@ int gnuboy_load_rom_file(const char *file)
 
 	byte header[0x200];
 
-	cart.romFile = fopen(file, "rb");
-	if (cart.romFile == NULL)
+	// Banks are loaded on demand and the least recently used ones are evicted when memory runs out
+	cart.romStream = rg_stream_open(file, "gb gbc", BANK_SIZE, 0);
+	if (cart.romStream == NULL)
 	{
-		MESSAGE_ERROR("ROM fopen failed\n");
+		MESSAGE_ERROR("ROM open failed\n");
 		return -1;
 	}
 
-	if (fread(&header, 0x200, 1, cart.romFile) != 1)
+	if (rg_stream_read(cart.romStream, 0, header, 0x200) != 0x200)
 	{
-		MESSAGE_ERROR("ROM fread failed\n");
-		fclose(cart.romFile);
-		cart.romFile = NULL;
+		MESSAGE_ERROR("ROM read failed\n");
+		rg_stream_close(cart.romStream);
+		cart.romStream = NULL;
 		return -1;
 	}
 
@@ -447,8 +446,10 @@ int gnuboy_load_rom_file(const char *file)
 	MESSAGE_INFO("Preloading the first %d banks\n", preload);
 	for (int i = 0; i < preload; i++)
 	{
-		gnuboy_load_bank(i);
+		if (!rg_stream_prefetch(cart.romStream, i % cart.romStream->page_count))
+			break;
 	}
+	sync_banks();
 
 	return 0;
 }
@@ -456,25 +457,19 @@ int gnuboy_load_rom_file(const char *file)
 
 void gnuboy_free_rom(void)
 {
-	// If cart.romFile isn't NULL it indicates that we haven't allocated those buffers, don't free them.
-	if (cart.romFile && cart.rombanks)
-	{
-		for (int i = 0; i < cart.romsize; i++)
-			free(cart.rombanks[i]);
-	}
+	// If cart.romStream isn't NULL it owns the banks, otherwise they point into the caller's buffer.
+	rg_stream_close(cart.romStream);
+	cart.romStream = NULL;
 
 	free(cart.rombanks);
 	cart.rombanks = NULL;
 
+	rg_sram_close(cart.sram);
+	cart.sram = NULL;
+
 	free(cart.rambanks);
 	cart.rambanks = NULL;
 
-	if (cart.romFile)
-	{
-		fclose(cart.romFile);
-		cart.romFile = NULL;
-	}
-
 	if (cart.sramFile)
 	{
 		fclose(cart.sramFile);
@@ -532,38 +527,63 @@ void gnuboy_set_palette(gb_palette_t pal)
 
 bool gnuboy_sram_dirty(void)
 {
-	return cart.sram_dirty != 0;
+	return cart.sram && rg_sram_is_dirty(cart.sram);
 }
 
 
+static bool write_rtc(FILE *f)
+{
+	uint64_t rt = RTC_BASE + cart.rtc.s + (cart.rtc.m * 60) + (cart.rtc.h * 3600) + (cart.rtc.d * 86400);
+	uint32_t *rtp = (uint32_t*)&rt;
+	uint32_t rtc_buf[12] = {
+		cart.rtc.s,
+		cart.rtc.m,
+		cart.rtc.h,
+		cart.rtc.d,
+		cart.rtc.flags,
+		cart.rtc.regs[0],
+		cart.rtc.regs[1],
+		cart.rtc.regs[2],
+		cart.rtc.regs[3],
+		cart.rtc.regs[4],
+		rtp[0],
+		rtp[1],
+	};
+	return fwrite(&rtc_buf, 48, 1, f) == 1;
+}
+
+
+/**
+ * The SRAM file is tracked by rg_sram, the banks are written back as they change (see hw.c).
+ * The RTC section follows the banks and is rewritten whenever they are.
+ */
 int gnuboy_load_sram(const char *file)
 {
 	if (!cart.has_battery || !cart.ramsize || !file || !*file)
 		return -1;
 
-	FILE *f = fopen(file, "rb");
-	if (!f)
-		return -2;
-
 	MESSAGE_INFO("Loading SRAM from '%s'\n", file);
 
-	cart.sram_dirty = 0;
-	cart.sram_saved = 0;
-
-	for (int i = 0; i < cart.ramsize; i++)
+	bool loaded;
+	if (cart.sram && strcmp(cart.sram->path, file) == 0)
 	{
-		if (fseek(f, i * 8192, SEEK_SET) == 0 && fread(cart.rambanks[i], 8192, 1, f) == 1)
-		{
-			MESSAGE_INFO("Loaded SRAM bank %d.\n", i);
-			cart.sram_saved = (1 << i);
-		}
+		loaded = rg_sram_load(cart.sram);
+	}
+	else
+	{
+		rg_sram_close(cart.sram);
+		cart.sram = rg_sram_open(file, cart.rambanks, cart.ramsize * 8192, 0);
+		loaded = cart.sram->complete;
 	}
 
 	if (cart.has_rtc)
 	{
+		cart.sram->write_extra = &write_rtc;
+
+		FILE *f = fopen(file, "rb");
 		uint32_t rtc_buf[12];
 
-		if (fseek(f, cart.ramsize * 8192, SEEK_SET) == 0 && fread(&rtc_buf, 48, 1, f) == 1)
+		if (f && fseek(f, cart.ramsize * 8192, SEEK_SET) == 0 && fread(&rtc_buf, 48, 1, f) == 1)
 		{
 			cart.rtc = (gb_rtc_t){
 				.s = rtc_buf[0],
@@ -575,76 +595,21 @@ int gnuboy_load_sram(const char *file)
 			};
 			MESSAGE_INFO("Loaded RTC section %03d %02d:%02d:%02d.\n", cart.rtc.d, cart.rtc.h, cart.rtc.m, cart.rtc.s);
 		}
-	}
 
-	fclose(f);
+		if (f)
+			fclose(f);
+	}
 
-	return cart.sram_saved ? 0 : -1;
+	return loaded ? 0 : -1;
 }
 
 
-/**
- * If quick_save is set to true, sram_save will only save the sectors that
- * changed + the rtc. If set to false then a full sram file is created.
- */
-int gnuboy_save_sram(const char *file, bool quick_save)
+int gnuboy_save_sram(void)
 {
-	if (!cart.has_battery || !cart.ramsize || !file || !*file)
+	if (!cart.sram)
 		return -1;
 
-	FILE *f = fopen(file, "wb");
-	if (!f)
-		return -2;
-
-	MESSAGE_INFO("Saving SRAM to '%s'...\n", file);
-
-	// Mark everything as dirty and unsaved (do a full save)
-	if (!quick_save)
-	{
-		cart.sram_dirty = (1 << cart.ramsize) - 1;
-		cart.sram_saved = 0;
-	}
-
-	for (int i = 0; i < cart.ramsize; i++)
-	{
-		if (!(cart.sram_saved & (1 << i)) || (cart.sram_dirty & (1 << i)))
-		{
-			if (fseek(f, i * 8192, SEEK_SET) == 0 && fwrite(cart.rambanks[i], 8192, 1, f) == 1)
-			{
-				MESSAGE_INFO("Saved SRAM bank %d.\n", i);
-				cart.sram_dirty &= ~(1 << i);
-				cart.sram_saved |= (1 << i);
-			}
-		}
-	}
-
-	if (cart.has_rtc)
-	{
-		uint64_t rt = RTC_BASE + cart.rtc.s + (cart.rtc.m * 60) + (cart.rtc.h * 3600) + (cart.rtc.d * 86400);
-		uint32_t *rtp = (uint32_t*)&rt;
-		uint32_t rtc_buf[12] = {
-			cart.rtc.s,
-			cart.rtc.m,
-			cart.rtc.h,
-			cart.rtc.d,
-			cart.rtc.flags,
-			cart.rtc.regs[0],
-			cart.rtc.regs[1],
-			cart.rtc.regs[2],
-			cart.rtc.regs[3],
-			cart.rtc.regs[4],
-			rtp[0],
-			rtp[1],
-		};
-		if (fseek(f, cart.ramsize * 8192, SEEK_SET) == 0 && fwrite(&rtc_buf, 48, 1, f) == 1)
-		{
-			MESSAGE_INFO("Saved RTC section.\n");
-		}
-	}
-
-	fclose(f);
-
-	return cart.sram_dirty ? -1 : 0;
+	return rg_sram_flush(cart.sram) ? 0 : -1;
 }
 
 
@@ -700,7 +665,7 @@ typedef struct
 } sblock_t;
 
 
-static int do_save_load(const char *file, bool save)
+static int do_save_load(FILE *fp, bool save)
 {
 	uint32_t sav_ver = SAVE_VERSION;
 	const svar_t svars[] =
@@ -785,13 +750,8 @@ static int do_save_load(const char *file, bool save)
 		{NULL, 0},
 	};
 
-	FILE *fp = NULL;
-
 	if (save)
 	{
-		if (!(fp = fopen(file, "wb")))
-			goto _error;
-
 		for (int i = 0; svars[i].ptr; i++)
 		{
 			uint32_t d = 0;
@@ -829,9 +789,6 @@ static int do_save_load(const char *file, bool save)
 	}
 	else
 	{
-		if (!(fp = fopen(file, "rb")))
-			goto _error;
-
 		for (int i = 0; blocks[i].ptr != NULL; i++)
 		{
 			if (fread(blocks[i].ptr, 4096, blocks[i].len, fp) < 1)
@@ -887,26 +844,46 @@ static int do_save_load(const char *file, bool save)
 		gb_hw_updatemap();
 	}
 
-	fclose(fp);
 	free(buf);
 
 	return 0;
 
 _error:
-	if (fp) fclose(fp);
-	if (buf) free(buf);
+	free(buf);
 
 	return -1;
 }
 
 
+int gnuboy_save_state_fp(FILE *fp)
+{
+	return do_save_load(fp, true);
+}
+
+
+int gnuboy_load_state_fp(FILE *fp)
+{
+	return do_save_load(fp, false);
+}
+
+
 int gnuboy_save_state(const char *file)
 {
-	return do_save_load(file, true);
+	FILE *fp = fopen(file, "wb");
+	if (!fp)
+		return -1;
+	int ret = do_save_load(fp, true);
+	fclose(fp);
+	return ret;
 }
 
 
 int gnuboy_load_state(const char *file)
 {
-	return do_save_load(file, false);
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+		return -1;
+	int ret = do_save_load(fp, false);
+	fclose(fp);
+	return ret;
 }
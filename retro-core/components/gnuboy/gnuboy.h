@@ -124,6 +124,8 @@ int  gnuboy_get_palette(void);
 void gnuboy_set_palette(gb_palette_t pal);
 
 int gnuboy_load_sram(const char *file);
-int gnuboy_save_sram(const char *file, bool quick_save);
+int gnuboy_save_sram(void);
 int gnuboy_load_state(const char *file);
 int gnuboy_save_state(const char *file);
+int gnuboy_load_state_fp(FILE *fp);
+int gnuboy_save_state_fp(FILE *fp);
@@ -252,7 +252,6 @@ void gb_hw_reset(bool hard)
 	memset(hw.rmap, 0, sizeof(hw.rmap));
 	memset(hw.wmap, 0, sizeof(hw.wmap));
 
-	cart.sram_dirty = 0;
 	cart.bankmode = 0;
 	cart.rombank = 1;
 	cart.rambank = 0;
@@ -292,6 +291,10 @@ void gb_hw_updatemap(void)
 	{
 		gnuboy_load_bank(rombank);
 	}
+	else if (cart.romStream)
+	{
+		rg_stream_touch(cart.romStream, rombank % cart.romStream->page_count);
+	}
 
 	// ROM
 	hw.rmap[0x0] = cart.rombanks[0];
@@ -493,7 +496,8 @@ void gb_hw_write(unsigned a, byte b)
 			if (cart.rambanks[cart.rambank][a & 0x1FFF] != b)
 			{
 				cart.rambanks[cart.rambank][a & 0x1FFF] = b;
-				cart.sram_dirty |= (1 << cart.rambank);
+				if (cart.sram)
+					rg_sram_mark(cart.sram, cart.rambank * 8192 + (a & 0x1FFF));
 			}
 		}
 		break;
@@ -183,8 +183,7 @@ typedef struct
 	// Memory
 	byte **rombanks; // [512];
 	byte (*rambanks)[8192];
-	unsigned sram_dirty;
-	unsigned sram_saved;
+	rg_sram_t *sram; // NULL unless the cart has a battery and gnuboy_load_sram was called
 
 	// Extra hardware
 	bool has_rumble;
@@ -201,7 +200,7 @@ typedef struct
 	int rambank;
 
 	// File descriptors that we keep open
-	FILE *romFile;
+	rg_stream_t *romStream; // NULL if the whole ROM was loaded with gnuboy_load_rom
 	FILE *sramFile;
 } gb_cart_t;
 
@@ -38,6 +38,7 @@ public:
    void SetEEPROMType(UBYTE b);
    int Size(void);
    void InitFrom(char *data,int count){ memcpy(romdata,data,__min(count,Size()));};
+   UBYTE *Data(void){ return (UBYTE *)romdata;};
 
    void Poke(ULONG addr,UBYTE data) { };
    UBYTE Peek(ULONG addr)
@@ -101,12 +101,23 @@ void apu_fc_advance(int cycles)
 
 void apu_setcontext(const apu_t *src)
 {
-   MESSAGE_ERROR("%s: Not implemented!\n", __func__);
+   /* buffer, luts, ext and options belong to the running instance */
+   memcpy(apu.rectangle, src->rectangle, sizeof(apu.rectangle));
+   apu.triangle = src->triangle;
+   apu.noise = src->noise;
+   apu.dmc = src->dmc;
+   apu.control_reg = src->control_reg;
+   apu.prev_sample = src->prev_sample;
+   apu.fc.state = src->fc.state;
+   apu.fc.step = src->fc.step;
+   apu.fc.cycles = src->fc.cycles;
+   apu.fc.irq_occurred = src->fc.irq_occurred;
+   apu.fc.disable_irq = src->fc.disable_irq;
 }
 
 void apu_getcontext(apu_t *dest)
 {
-   MESSAGE_ERROR("%s: Not implemented!\n", __func__);
+   *dest = apu;
 }
 
 static void apu_build_luts(int num_samples)
@@ -1103,13 +1103,23 @@ static nes6502_t cpu;
 /* set the current context */
 void nes6502_setcontext(const nes6502_t *src)
 {
-   MESSAGE_ERROR("%s: Not implemented!\n", __func__);
+   /* the memory map pointers belong to the running instance */
+   cpu.pc_reg = src->pc_reg;
+   cpu.a_reg = src->a_reg;
+   cpu.x_reg = src->x_reg;
+   cpu.y_reg = src->y_reg;
+   cpu.s_reg = src->s_reg;
+   cpu.p_reg = src->p_reg;
+   cpu.int_pending = src->int_pending;
+   cpu.jammed = src->jammed;
+   cpu.total_cycles = src->total_cycles;
+   cpu.burn_cycles = src->burn_cycles;
 }
 
 /* get the current context */
 void nes6502_getcontext(nes6502_t *context)
 {
-   MESSAGE_ERROR("%s: Not implemented!\n", __func__);
+   *context = cpu;
 }
 
 /* get number of elapsed cycles */
@@ -66,12 +66,37 @@ INLINE uint8 PPU_MEM_READ(uint32 x)
 
 void ppu_setcontext(const ppu_t *src)
 {
-   MESSAGE_ERROR("%s: Not implemented!\n", __func__);
+   /* memory, paging, callbacks and options belong to the running instance */
+   memcpy(ppu.palette, src->palette, sizeof(ppu.palette));
+   ppu.ctrl0 = src->ctrl0;
+   ppu.ctrl1 = src->ctrl1;
+   ppu.stat = src->stat;
+   ppu.oam_addr = src->oam_addr;
+   ppu.nametab_base = src->nametab_base;
+   ppu.latch = src->latch;
+   ppu.vdata_latch = src->vdata_latch;
+   ppu.tile_xofs = src->tile_xofs;
+   ppu.flipflop = src->flipflop;
+   ppu.vaddr = src->vaddr;
+   ppu.vaddr_latch = src->vaddr_latch;
+   ppu.vaddr_inc = src->vaddr_inc;
+   ppu.obj_height = src->obj_height;
+   ppu.obj_base = src->obj_base;
+   ppu.bg_base = src->bg_base;
+   ppu.left_bg_on = src->left_bg_on;
+   ppu.left_obj_on = src->left_obj_on;
+   ppu.bg_on = src->bg_on;
+   ppu.obj_on = src->obj_on;
+   ppu.strikeflag = src->strikeflag;
+   ppu.strike_cycle = src->strike_cycle;
+   ppu.left_bg_counter = src->left_bg_counter;
+   ppu.vram_accessible = src->vram_accessible;
+   ppu.vram_present = src->vram_present;
 }
 
 void ppu_getcontext(ppu_t *dest)
 {
-   MESSAGE_ERROR("%s: Not implemented!\n", __func__);
+   *dest = ppu;
 }
 
 void ppu_setpage(uint32 page, uint8 *location)
@@ -27,37 +27,16 @@
 
 static rom_t rom;
 
-/* Save battery-backed RAM */
-void rom_savesram(const char *filename)
+/* Games missing from the database are assumed to be NTSC unless the name says otherwise */
+static void rom_detect_region(const char *filename)
 {
-   if (!rom.battery || rom.prg_ram_banks < 1)
+   if (rom.system == SYS_UNKNOWN && filename)
    {
-      MESSAGE_ERROR("ROM: Game has no battery-backed SRAM!\n");
-      return;
-   }
-   FILE *fp = fopen(filename, "wb");
-   if (fp)
-   {
-      fwrite(rom.prg_ram, ROM_PRG_BANK_SIZE, rom.prg_ram_banks, fp);
-      fclose(fp);
-      MESSAGE_INFO("ROM: Wrote battery RAM to %s.\n", filename);
-   }
-}
-
-/* Load battery-backed RAM from disk */
-void rom_loadsram(const char *filename)
-{
-   if (!rom.battery || rom.prg_ram_banks < 1)
-   {
-      MESSAGE_ERROR("ROM: Game has no battery-backed SRAM!\n");
-      return;
-   }
-   FILE *fp = fopen(filename, "rb");
-   if (fp)
-   {
-      fread(rom.prg_ram, ROM_PRG_BANK_SIZE, rom.prg_ram_banks, fp);
-      fclose(fp);
-      MESSAGE_INFO("ROM: Read battery RAM from %s.\n", filename);
+      if (strstr(filename, "(E)")
+         || strstr(filename, "(Europe)")
+         || strstr(filename, "(A)")
+         || strstr(filename, "(Australia)"))
+         rom.system = SYS_NES_PAL;
    }
 }
 
@@ -272,19 +251,42 @@ rom_t *rom_loadfile(const char *filename)
       return NULL;
    }
 
-   if (rom.system == SYS_UNKNOWN)
-   {
-      if (strstr(filename, "(E)")
-         || strstr(filename, "(Europe)")
-         || strstr(filename, "(A)")
-         || strstr(filename, "(Australia)"))
-         rom.system = SYS_NES_PAL;
-   }
+   rom_detect_region(filename);
    rom.free_data_ptr = true;
    rom.filename = strdup(filename);
    return &rom;
 }
 
+/* Load a ROM from a read-only buffer (eg a flash or file mapping) */
+rom_t *rom_loadmap(const uint8 *data, size_t size, const char *filename)
+{
+   rom_free();
+
+   if (rom_loadmem((uint8 *)data, size) == NULL)
+      return NULL;
+
+   /* The PPU writes through its pages ($2007), so CHR-ROM has to live in RAM */
+   if (rom.chr_rom)
+   {
+      size_t chr_size = rom.chr_rom_banks * ROM_CHR_BANK_SIZE;
+      size_t available = MIN(chr_size, (size_t)(data + size - rom.chr_rom));
+      uint8 *chr_rom = calloc(1, chr_size);
+      if (!chr_rom)
+      {
+         MESSAGE_ERROR("ROM: Memory allocation failed!\n");
+         rom_free();
+         return NULL;
+      }
+      memcpy(chr_rom, rom.chr_rom, available);
+      rom.chr_rom = chr_rom;
+      rom.free_chr_rom = true;
+   }
+
+   rom_detect_region(filename);
+   rom.filename = filename ? strdup(filename) : NULL;
+   return &rom;
+}
+
 /* Free a ROM */
 void rom_free(void)
 {
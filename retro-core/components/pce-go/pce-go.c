@@ -334,25 +334,18 @@ RunPCE(void)
 
 
 /**
- * Load saved state
+ * Load saved state from an open file
  */
 int
-LoadState(const char *name)
+LoadStateFP(FILE *fp)
 {
-	MESSAGE_INFO("Loading state from %s...\n", name);
-
 	char buffer[32];
 	block_hdr_t block;
-	int ret = -1;
-
-	FILE *fp = fopen(name, "rb");
-	if (fp == NULL)
-		return -1;
 
 	if (!fread(&buffer, 8, 1, fp) || memcmp(&buffer, SAVESTATE_HEADER, 8) != 0)
 	{
 		MESSAGE_ERROR("Loading state failed: Header mismatch\n");
-		goto _cleanup;
+		return -1;
 	}
 
 	while (fread(&block, sizeof(block), 1, fp))
@@ -368,13 +361,13 @@ LoadState(const char *name)
 				if (!fread(ptr, len, 1, fp))
 				{
 					MESSAGE_ERROR("fread error reading block data\n");
-					goto _cleanup;
+					return -1;
 				}
 				if (len < var->desc.len)
 				{
 					memset(ptr + len, 0, var->desc.len - len);
 				}
-				MESSAGE_INFO("Loaded %s\n", var->desc.key);
+				MESSAGE_DEBUG("Loaded %s\n", var->desc.key);
 				break;
 			}
 		}
@@ -386,29 +379,36 @@ LoadState(const char *name)
 
 	gfx_reset(true);
 	PCE.VDC.mode_chg = 1;
-	ret = 0;
 
-_cleanup:
-	fclose(fp);
-
-	return ret;
+	return 0;
 }
 
 
 /**
- * Save current state
+ * Load saved state
  */
 int
-SaveState(const char *name)
+LoadState(const char *name)
 {
-	MESSAGE_INFO("Saving state to %s...\n", name);
-
-	int ret = -1;
+	MESSAGE_INFO("Loading state from %s...\n", name);
 
-	FILE *fp = fopen(name, "wb");
+	FILE *fp = fopen(name, "rb");
 	if (fp == NULL)
 		return -1;
 
+	int ret = LoadStateFP(fp);
+	fclose(fp);
+
+	return ret;
+}
+
+
+/**
+ * Save current state to an open file
+ */
+int
+SaveStateFP(FILE *fp)
+{
 	fwrite(SAVESTATE_HEADER, sizeof(SAVESTATE_HEADER), 1, fp);
 
 	for (save_var_t *var = SaveStateVars; var->ptr; var++)
@@ -418,19 +418,33 @@ SaveState(const char *name)
 		if (!fwrite(&var->desc, sizeof(var->desc), 1, fp))
 		{
 			MESSAGE_ERROR("fwrite error desc\n");
-			goto _cleanup;
+			return -1;
 		}
 		if (!fwrite(ptr, len, 1, fp))
 		{
 			MESSAGE_ERROR("fwrite error value\n");
-			goto _cleanup;
+			return -1;
 		}
-		MESSAGE_INFO("Saved %s\n", var->desc.key);
+		MESSAGE_DEBUG("Saved %s\n", var->desc.key);
 	}
 
-	ret = 0;
+	return 0;
+}
+
+
+/**
+ * Save current state
+ */
+int
+SaveState(const char *name)
+{
+	MESSAGE_INFO("Saving state to %s...\n", name);
+
+	FILE *fp = fopen(name, "wb");
+	if (fp == NULL)
+		return -1;
 
-_cleanup:
+	int ret = SaveStateFP(fp);
 	fclose(fp);
 
 	return ret;
@@ -72,6 +72,8 @@
 
 int LoadState(const char *name);
 int SaveState(const char *name);
+int LoadStateFP(FILE *fp);
+int SaveStateFP(FILE *fp);
 void ResetPCE(bool);
 void RunPCE(void);
 void ShutdownPCE();
@@ -216,7 +216,8 @@ void system_load_state(void *mem)
 
   /** restore video & audio settings (needed if timing changed) ***/
   vdp_init();
-  sound_init();
+  if (snd.fps != ((sms.display == DISPLAY_NTSC) ? FPS_NTSC : FPS_PAL))
+    sound_init();
 
   /*** Set cart info ***/
   for (i = 0; i < 4; i++)
@@ -263,16 +264,14 @@ void system_load_state(void *mem)
   bufferptr += FM_GetContextSize ();
 #endif
 
-  // Preserve clock rate
+  // Preserve clock rate (Clock is only the fractional accumulator and is part of the state)
   SN76489_Context* psg = (SN76489_Context*)SN76489_GetContextPtr(0);
-  float psg_Clock = psg->Clock;
   float psg_dClock = psg->dClock;
 
   /*** Set SN76489 ***/
   fread(SN76489_GetContextPtr(0), SN76489_GetContextSize(), 1, mem);
 
   // Restore clock rate
-  psg->Clock = psg_Clock;
   psg->dClock = psg_dClock;
 
   fread(&coleco.pio_mode, 1, 1, mem);
@@ -11,13 +11,14 @@ static int audio_time;
 
 static const char *sramFile;
 static int autoSaveSRAM = 0;
-static int autoSaveSRAM_Timer = 0;
 static bool useSystemTime = true;
 static bool loadBIOSFile = false;
 
 static rg_app_t *app;
-static rg_surface_t *updates[2];
-static rg_surface_t *currentUpdate;
+static rg_surface_t *updates[3];
+static rg_surface_t *currentUpdate; // Last complete frame
+static rg_surface_t *nextUpdate;    // Frame being drawn by the emulator
+static uint32_t dirtyLines[(GB_HEIGHT + 31) / 32];
 
 static const char *SETTING_SAVESRAM = "SaveSRAM";
 static const char *SETTING_PALETTE  = "Palette";
@@ -69,19 +70,44 @@ static bool load_state_handler(const char *filename)
     update_rtc_time();
 
     skipFrames = 0;
-    autoSaveSRAM_Timer = 0;
 
     // TO DO: Call rtc_sync() if a physical RTC is present
     return true;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_storage_memopen(buffer, *size, "wb");
+    if (!fp)
+        return false;
+    bool success = gnuboy_save_state_fp(fp) == 0 && fseek(fp, 0, SEEK_END) == 0 && !ferror(fp);
+    *size = ftell(fp);
+    fclose(fp);
+    return success;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    FILE *fp = rg_storage_memopen((void *)buffer, size, "rb");
+    if (!fp)
+        return false;
+    bool success = gnuboy_load_state_fp(fp) == 0;
+    fclose(fp);
+    update_rtc_time();
+    return success;
+}
+
 static bool reset_handler(bool hard)
 {
+    // A hard reset wipes the cart RAM but the battery would have kept it
+    if (hard)
+        gnuboy_save_sram();
     gnuboy_reset(hard);
+    if (hard)
+        gnuboy_load_sram(sramFile);
     update_rtc_time();
 
     skipFrames = 0;
-    autoSaveSRAM_Timer = 0;
 
     return true;
 }
@@ -137,6 +163,7 @@ static rg_gui_event_t sram_autosave_cb(rg_gui_option_t *option, rg_gui_event_t e
     if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
     {
         rg_settings_set_number(NS_APP, SETTING_SAVESRAM, autoSaveSRAM);
+        rg_sram_set_autosave(autoSaveSRAM);
     }
 
     if (autoSaveSRAM == 0) strcpy(option->value, _("Off"));
@@ -220,7 +247,10 @@ static void video_callback(void *buffer)
 {
     int64_t startTime = rg_system_timer();
     slowFrame = !rg_display_sync(false);
-    rg_display_submit(currentUpdate, 0);
+    rg_surface_t *previousUpdate = currentUpdate;
+    currentUpdate = nextUpdate;
+    bool diff = rg_surface_diff_lines(previousUpdate, currentUpdate, dirtyLines);
+    nextUpdate = rg_display_swap_lines(currentUpdate, diff ? dirtyLines : NULL, 0);
     video_time += rg_system_timer() - startTime;
 }
 
@@ -232,6 +262,13 @@ static void audio_callback(void *buffer, size_t length)
     audio_time += rg_system_timer() - startTime;
 }
 
+static void run_frame(bool draw)
+{
+    if (draw)
+        gnuboy_set_framebuffer(nextUpdate->data);
+    gnuboy_run(draw);
+}
+
 static void options_handler(rg_gui_option_t *dest)
 {
     *dest++ = (rg_gui_option_t){0, _("Palette"),       "-", RG_DIALOG_FLAG_NORMAL, &palette_update_cb};
@@ -246,6 +283,8 @@ void gbc_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
@@ -256,29 +295,35 @@ void gbc_main(void)
 
     updates[0] = rg_surface_create(GB_WIDTH, GB_HEIGHT, RG_PIXEL_565_BE, MEM_ANY);
     updates[1] = rg_surface_create(GB_WIDTH, GB_HEIGHT, RG_PIXEL_565_BE, MEM_ANY);
-    currentUpdate = updates[0];
+    updates[2] = rg_surface_create(GB_WIDTH, GB_HEIGHT, RG_PIXEL_565_BE, MEM_ANY);
+    currentUpdate = nextUpdate = rg_display_swap_init(updates);
 
     useSystemTime = (bool)rg_settings_get_number(NS_APP, SETTING_SYSTIME, 1);
     loadBIOSFile = (bool)rg_settings_get_number(NS_APP, SETTING_LOADBIOS, 0);
     autoSaveSRAM = (int)rg_settings_get_number(NS_APP, SETTING_SAVESRAM, 0);
     sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, app->romPath);
-
-    if (!rg_storage_mkdir(rg_dirname(sramFile)))
-        RG_LOGE("Unable to create SRAM folder...");
+    rg_sram_set_autosave(autoSaveSRAM);
 
     // Initialize the emulator
     if (gnuboy_init(app->sampleRate, GB_AUDIO_STEREO_S16, GB_PIXEL_565_BE, &video_callback, &audio_callback) < 0)
         RG_PANIC("Emulator init failed!");
 
-    gnuboy_set_framebuffer(currentUpdate->data);
+    gnuboy_set_framebuffer(nextUpdate->data);
     gnuboy_set_soundbuffer(malloc(AUDIO_BUFFER_LENGTH * 4), AUDIO_BUFFER_LENGTH);
 
     // Load ROM
-    if (rg_extension_match(app->romPath, "zip"))
+    const void *rom_data;
+    size_t rom_size;
+    if (rg_storage_map_rom(app->romPath, &rom_data, &rom_size))
+    {
+        if (gnuboy_load_rom(rom_data, rom_size) < 0)
+            RG_PANIC("ROM Loading failed!");
+    }
+    else if (rg_extension_match(app->romPath, "zip"))
     {
         void *data;
         size_t size;
-        if (!rg_storage_unzip_file(app->romPath, NULL, &data, &size, RG_FILE_ALIGN_16KB))
+        if (!rg_storage_unzip_file(app->romPath, "gb gbc", &data, &size, RG_FILE_ALIGN_16KB))
             RG_PANIC("ROM file unzipping failed!");
         if (gnuboy_load_rom(data, size) < 0)
             RG_PANIC("ROM Loading failed!");
@@ -302,14 +347,15 @@ void gbc_main(void)
     // Hard reset to have a clean slate
     gnuboy_reset(true);
 
-    // Load saved state or SRAM
+    // Load SRAM, then the saved state which will overwrite it
+    gnuboy_load_sram(sramFile);
     if (app->bootFlags & RG_BOOT_RESUME)
         rg_emu_load_state(app->saveSlot);
-    else
-        gnuboy_load_sram(sramFile);
 
     update_rtc_time();
 
+    rg_system_set_tick_pacing(true);
+
     // Ready!
 
     uint32_t joystick_old = -1;
@@ -324,7 +370,7 @@ void gbc_main(void)
             if (joystick & RG_KEY_MENU)
             {
                 if (gnuboy_sram_dirty()) // save in case the user quits
-                    gnuboy_save_sram(sramFile, false);
+                    gnuboy_save_sram();
                 rg_gui_game_menu();
             }
             else
@@ -350,27 +396,7 @@ void gbc_main(void)
 
         video_time = audio_time = 0;
 
-        if (drawFrame)
-        {
-            currentUpdate = updates[currentUpdate == updates[0]];
-            gnuboy_set_framebuffer(currentUpdate->data);
-        }
-        gnuboy_run(drawFrame);
-
-        if (autoSaveSRAM > 0)
-        {
-            if (autoSaveSRAM_Timer <= 0)
-            {
-                if (gnuboy_sram_dirty())
-                {
-                    autoSaveSRAM_Timer = autoSaveSRAM * 60;
-                }
-            }
-            else if (--autoSaveSRAM_Timer == 0)
-            {
-                gnuboy_save_sram(sramFile, true);
-            }
-        }
+        rg_emu_run_frame(&run_frame, drawFrame);
 
         // Tick before submitting audio/syncing
         rg_system_tick(rg_system_timer() - startTime - audio_time);
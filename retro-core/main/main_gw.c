@@ -89,6 +89,22 @@ static bool gw_system_LoadState(const char *pathName)
     return success;
 }
 
+static bool gw_system_SaveStateMem(void *buffer, size_t *size)
+{
+    if (*size < sizeof(gw_state_t))
+        return false;
+    memset(buffer, 0, sizeof(gw_state_t));
+    *size = sizeof(gw_state_t);
+    return gw_state_save(buffer);
+}
+
+static bool gw_system_LoadStateMem(const void *buffer, size_t size)
+{
+    if (size < sizeof(gw_state_t))
+        return false;
+    return gw_state_load((void *)buffer);
+}
+
 /* callback to get buttons state */
 unsigned int gw_get_buttons()
 {
@@ -132,6 +148,8 @@ void gw_main(void)
     const rg_handlers_t handlers = {
         .loadState = &gw_system_LoadState,
         .saveState = &gw_system_SaveState,
+        .loadStateMem = &gw_system_LoadStateMem,
+        .saveStateMem = &gw_system_SaveStateMem,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
     };
@@ -226,6 +244,7 @@ void gw_main(void)
     printf("Main emulator loop start\n");
 
     rg_system_set_tick_rate(GW_REFRESH_RATE);
+    rg_system_set_tick_pacing(true);
 
     while (true)
     {
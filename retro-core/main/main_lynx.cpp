@@ -8,6 +8,7 @@ extern "C" {
 #include <handy.h>
 
 static CSystem *lynx = NULL;
+static rg_sram_t *eeprom = NULL;
 
 static int dpad_mapped_up;
 static int dpad_mapped_down;
@@ -93,7 +94,7 @@ static CSystem *new_lynx(void)
     {
         void *data;
         size_t size;
-        if (!rg_storage_unzip_file(app->romPath, NULL, &data, &size, 0))
+        if (!rg_storage_unzip_file(app->romPath, "lnx", &data, &size, 0))
             RG_PANIC("ROM file unzipping failed!");
         CSystem *lynx = new CSystem((UBYTE*)data, size, MIKIE_PIXEL_FORMAT_16BPP_565_BE, app->sampleRate);
         free(data);
@@ -102,6 +103,16 @@ static CSystem *new_lynx(void)
     return new CSystem(app->romPath, MIKIE_PIXEL_FORMAT_16BPP_565_BE, app->sampleRate);
 }
 
+static void open_eeprom(void)
+{
+    if (lynx->mEEPROM->Available())
+    {
+        char *sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, app->romPath);
+        eeprom = rg_sram_open(sramFile, lynx->mEEPROM->Data(), lynx->mEEPROM->Size(), RG_SRAM_AUTODETECT);
+        free(sramFile);
+    }
+}
+
 
 static rg_gui_event_t rotation_cb(rg_gui_option_t *option, rg_gui_event_t event)
 {
@@ -171,11 +182,34 @@ static bool load_state_handler(const char *filename)
     return ret;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_storage_memopen(buffer, *size, "wb");
+    if (!fp)
+        return false;
+    bool success = lynx->ContextSave(fp) && fseek(fp, 0, SEEK_END) == 0 && !ferror(fp);
+    *size = ftell(fp);
+    fclose(fp);
+    return success;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    FILE *fp = rg_storage_memopen((void *)buffer, size, "rb");
+    bool ret = fp && lynx->ContextLoad(fp);
+    if (fp) fclose(fp);
+    if (!ret) lynx->Reset();
+    return ret;
+}
+
 static bool reset_handler(bool hard)
 {
     // This isn't nice but lynx->Reset() crashes...
+    rg_sram_close(eeprom);
+    eeprom = NULL;
     delete lynx;
     lynx = new_lynx();
+    open_eeprom();
     return true;
 }
 
@@ -190,6 +224,8 @@ extern "C" void lynx_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
@@ -214,6 +250,8 @@ extern "C" void lynx_main(void)
         RG_PANIC("ROM loading failed!");
     }
 
+    open_eeprom();
+
     gPrimaryFrameBuffer = (UBYTE*)currentUpdate->data;
     gAudioBuffer = new SWORD[AUDIO_BUFFER_LENGTH * 2];
     gAudioEnabled = 1;
@@ -228,6 +266,8 @@ extern "C" void lynx_main(void)
     long skipFrames = 0;
     bool slowFrame = false;
 
+    rg_system_set_tick_pacing(true);
+
     // Start emulation
     while (1)
     {
@@ -8,10 +8,13 @@ static int palette = 0;
 static bool slowFrame = false;
 static bool nsfPlayer = false;
 static nes_t *nes;
+static rg_sram_t *sram; // Battery-backed PRG-RAM
 
 static rg_app_t *app;
-static rg_surface_t *updates[2];
-static rg_surface_t *currentUpdate;
+static rg_surface_t *updates[3];
+static rg_surface_t *currentUpdate; // Last complete frame
+static rg_surface_t *nextUpdate;    // Frame being drawn by the emulator
+static uint32_t dirtyLines[(NES_SCREEN_HEIGHT + 31) / 32];
 
 static const char *SETTING_AUTOCROP = "autocrop";
 static const char *SETTING_OVERSCAN = "overscan";
@@ -41,19 +44,100 @@ static bool save_state_handler(const char *filename)
     return state_save(filename) == 0;
 }
 
+static void hard_reset(void)
+{
+    // Unlike the emulator, the battery keeps the PRG-RAM across resets
+    nes_reset(true);
+    if (sram)
+        rg_sram_load(sram);
+}
+
 static bool load_state_handler(const char *filename)
 {
     if (state_load(filename) != 0)
     {
-        nes_reset(true);
+        hard_reset();
+        return false;
+    }
+    return true;
+}
+
+// SNSS only has the registers that the format knows about, the full contexts follow it so that
+// restoring a state in memory (rewind, run-ahead) doesn't disturb the video or the notes being played.
+// The contexts are raw structs (only their plain fields are restored), a footer identifies them so that
+// states written by another build or plain SNSS data fall back to what SNSS alone restores.
+#define CONTEXT_MAGIC   0x5843454E // "NECX"
+#define CONTEXT_VERSION 1
+static struct
+{
+    nes6502_t cpu;
+    ppu_t ppu;
+    apu_t apu;
+    int32_t cycles;
+} context;
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t length;
+} context_footer_t;
+
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_storage_memopen(buffer, *size, "wb");
+    if (!fp)
+        return false;
+    nes6502_getcontext(&context.cpu);
+    ppu_getcontext(&context.ppu);
+    apu_getcontext(&context.apu);
+    context.cycles = nes->cycles;
+    context_footer_t footer = {CONTEXT_MAGIC, CONTEXT_VERSION, sizeof(context)};
+    bool success = state_save_fp(fp) == 0 && fseek(fp, 0, SEEK_END) == 0;
+    success = success && fwrite(&context, sizeof(context), 1, fp) == 1;
+    success = success && fwrite(&footer, sizeof(footer), 1, fp) == 1 && !ferror(fp);
+    *size = ftell(fp);
+    fclose(fp);
+    return success;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    FILE *fp = rg_storage_memopen((void *)buffer, size, "rb");
+    if (!fp || state_load_fp(fp) != 0)
+    {
+        if (fp)
+            fclose(fp);
+        hard_reset();
         return false;
     }
+    context_footer_t footer = {0};
+    long offset = -(long)(sizeof(footer) + sizeof(context));
+    if (size > sizeof(footer) + sizeof(context) && fseek(fp, -(long)sizeof(footer), SEEK_END) == 0
+        && fread(&footer, sizeof(footer), 1, fp) == 1 && footer.magic == CONTEXT_MAGIC
+        && footer.version == CONTEXT_VERSION && footer.length == sizeof(context)
+        && fseek(fp, offset, SEEK_END) == 0 && fread(&context, sizeof(context), 1, fp) == 1)
+    {
+        nes6502_setcontext(&context.cpu);
+        ppu_setcontext(&context.ppu);
+        apu_setcontext(&context.apu);
+        nes->cycles = context.cycles;
+    }
+    else
+    {
+        RG_LOGW("State has no usable context, restored from SNSS only");
+    }
+    fclose(fp);
     return true;
 }
 
 static bool reset_handler(bool hard)
 {
-    nes_reset(hard);
+    if (hard && sram)
+        rg_sram_flush(sram);
+    if (hard)
+        hard_reset();
+    else
+        nes_reset(false);
     return true;
 }
 
@@ -65,6 +149,7 @@ static void build_palette(int n)
         uint16_t color = (pal[i] >> 8) | ((pal[i]) << 8);
         updates[0]->palette[i] = color;
         updates[1]->palette[i] = color;
+        updates[2]->palette[i] = color;
     }
     free(pal);
 }
@@ -156,10 +241,28 @@ static void blit_screen(uint8 *bmp)
     int crop_v = (overscan) ? nes->overscan : 0;
     int crop_h = (autocrop) ? 8 : 0;
     // crop_h = (autocrop == 2) || (autocrop == 1 && nes->ppu->left_bg_counter > 210) ? 8 : 0;
+    // A NULL bmp is a redraw request, the last frame is sent again
+    rg_surface_t *previousUpdate = currentUpdate;
+    if (bmp)
+        currentUpdate = nextUpdate;
     currentUpdate->width = NES_SCREEN_WIDTH - crop_h * 2;
     currentUpdate->height = NES_SCREEN_HEIGHT - crop_v * 2;
     currentUpdate->offset = crop_v * currentUpdate->stride + crop_h + 8;
-    rg_display_submit(currentUpdate, 0);
+    if (bmp)
+    {
+        // Most games only change a few lines per frame, the display can skip the others
+        bool diff = rg_surface_diff_lines(previousUpdate, currentUpdate, dirtyLines);
+        nextUpdate = rg_display_swap_lines(currentUpdate, diff ? dirtyLines : NULL, 0);
+    }
+    else
+        rg_display_submit(currentUpdate, 0);
+}
+
+static void run_frame(bool draw)
+{
+    if (draw)
+        nes_setvidbuf(nextUpdate->data);
+    nes_emulate(draw);
 }
 
 static void nsf_draw_overlay(void)
@@ -193,6 +296,8 @@ void nes_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .event = &event_handler,
         .screenshot = &screenshot_handler,
@@ -207,19 +312,34 @@ void nes_main(void)
 
     updates[0] = rg_surface_create(NES_SCREEN_PITCH, NES_SCREEN_HEIGHT, RG_PIXEL_PAL565_BE, MEM_FAST);
     updates[1] = rg_surface_create(NES_SCREEN_PITCH, NES_SCREEN_HEIGHT, RG_PIXEL_PAL565_BE, MEM_FAST);
-    currentUpdate = updates[0];
+    updates[2] = rg_surface_create(NES_SCREEN_PITCH, NES_SCREEN_HEIGHT, RG_PIXEL_PAL565_BE, MEM_FAST);
+    currentUpdate = nextUpdate = rg_display_swap_init(updates);
 
     nes = nes_init(SYS_DETECT, app->sampleRate, true, RG_BASE_PATH_BIOS "/fds_bios.bin");
     if (!nes)
         RG_PANIC("Init failed.");
 
     int ret = -1;
+    const void *rom_data;
+    size_t rom_size;
+
+    // FDS disks are written to, only iNES images can run from a read-only mapping (CHR-ROM is copied)
+    bool mapped = rg_storage_map_rom(app->romPath, &rom_data, &rom_size);
+    if (mapped && (rom_size <= 16 || memcmp(rom_data, ROM_NES_MAGIC, 4) != 0))
+    {
+        rg_storage_unmap_rom();
+        mapped = false;
+    }
 
-    if (rg_extension_match(app->romPath, "zip"))
+    if (mapped)
+    {
+        ret = nes_insertcart(rom_loadmap(rom_data, rom_size, app->romPath));
+    }
+    else if (rg_extension_match(app->romPath, "zip"))
     {
         void *data;
         size_t size;
-        if (!rg_storage_unzip_file(app->romPath, NULL, &data, &size, RG_FILE_ALIGN_8KB))
+        if (!rg_storage_unzip_file(app->romPath, "nes fc fds nsf", &data, &size, RG_FILE_ALIGN_8KB))
             RG_PANIC("ROM file unzipping failed!");
         ret = nes_insertcart(rom_loadmem(data, size));
     }
@@ -241,6 +361,14 @@ void nes_main(void)
 
     nsfPlayer = nes->cart->type == ROM_TYPE_NSF;
 
+    // PRG-RAM is written through the memory map, there's no write hook to mark its pages
+    if (nes->cart->battery && nes->cart->prg_ram_banks > 0 && !nsfPlayer)
+    {
+        char *sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, app->romPath);
+        sram = rg_sram_open(sramFile, nes->cart->prg_ram, nes->cart->prg_ram_banks * ROM_PRG_BANK_SIZE, RG_SRAM_AUTODETECT);
+        free(sramFile);
+    }
+
     ppu_setopt(PPU_LIMIT_SPRITES, rg_settings_get_number(NS_APP, SETTING_SPRITELIMIT, 1));
 
     build_palette(palette);
@@ -256,6 +384,7 @@ void nes_main(void)
     }
 
     rg_system_set_tick_rate(nes->refresh_rate);
+    rg_system_set_tick_pacing(true);
 
     int skipFrames = 0;
 
@@ -284,19 +413,12 @@ void nes_main(void)
         if (joystick & RG_KEY_A)      buttons |= NES_PAD_A;
         if (joystick & RG_KEY_B)      buttons |= NES_PAD_B;
 
-        if (drawFrame)
-        {
-            currentUpdate = updates[currentUpdate == updates[0]];
-            nes_setvidbuf(currentUpdate->data);
-        }
-
         input_update(0, buttons);
-        nes_emulate(drawFrame);
+        rg_emu_run_frame(&run_frame, drawFrame);
 
-        // Tick before submitting audio/syncing
+        // Tick before submitting audio/syncing (this is where we wait for the next frame)
         rg_system_tick(rg_system_timer() - startTime);
 
-        // Audio is used to pace emulation :)
         rg_audio_submit((void*)nes->apu->buffer, nes->apu->samples_per_frame);
 
         if (skipFrames == 0)
@@ -78,6 +78,10 @@ void osd_vsync(void)
     int frameTime = app->frameTime;
     int sleep = frameTime - (curtime - lasttime);
 
+#ifdef RG_ENABLE_BENCHMARK
+    sleep = 0; // Benchmark runs are unpaced and must not skip frames based on time
+#endif
+
     if (sleep > frameTime)
     {
         RG_LOGE("Our vsync timer seems to have overflowed! (%dus)", sleep);
@@ -175,6 +179,31 @@ static bool load_state_handler(const char *filename)
     return true;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_storage_memopen(buffer, *size, "wb");
+    if (!fp)
+        return false;
+    bool success = SaveStateFP(fp) == 0 && fseek(fp, 0, SEEK_END) == 0 && !ferror(fp);
+    *size = ftell(fp);
+    fclose(fp);
+    return success;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    FILE *fp = rg_storage_memopen((void *)buffer, size, "rb");
+    if (!fp || LoadStateFP(fp) != 0)
+    {
+        if (fp)
+            fclose(fp);
+        ResetPCE(false);
+        return false;
+    }
+    fclose(fp);
+    return true;
+}
+
 static bool reset_handler(bool hard)
 {
     ResetPCE(hard);
@@ -192,6 +221,8 @@ void pce_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
@@ -228,7 +259,7 @@ void pce_main(void)
     {
         void *data;
         size_t size;
-        if (!rg_storage_unzip_file(app->romPath, NULL, &data, &size, RG_FILE_ALIGN_8KB))
+        if (!rg_storage_unzip_file(app->romPath, "pce", &data, &size, RG_FILE_ALIGN_8KB))
             RG_PANIC("ROM file unzipping failed!");
         if (LoadCard(data, size) != 0)
             RG_PANIC("ROM loading failed");
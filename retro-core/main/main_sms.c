@@ -5,6 +5,10 @@
 static rg_app_t *app;
 static rg_surface_t *updates[2];
 static rg_surface_t *currentUpdate;
+static bool slowFrame = false;
+
+static rg_audio_mixer_t *mixer;
+static int psg_left, psg_right;
 
 const rg_keyboard_map_t coleco_keyboard = {
     .columns = 3,
@@ -59,6 +63,28 @@ static bool load_state_handler(const char *filename)
     return false;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_storage_memopen(buffer, *size, "wb");
+    if (!fp)
+        return false;
+    system_save_state(fp);
+    bool success = fseek(fp, 0, SEEK_END) == 0 && !ferror(fp);
+    *size = ftell(fp);
+    fclose(fp);
+    return success;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    FILE *fp = rg_storage_memopen((void *)buffer, size, "rb");
+    if (!fp)
+        return false;
+    system_load_state(fp);
+    fclose(fp);
+    return true;
+}
+
 static bool reset_handler(bool hard)
 {
     system_reset();
@@ -93,6 +119,22 @@ static rg_gui_event_t palette_update_cb(rg_gui_option_t *opt, rg_gui_event_t eve
     return RG_DIALOG_VOID;
 }
 
+static void run_frame(bool draw)
+{
+    system_frame(!draw);
+
+    // Submitted right away, loading a state (run-ahead) clears the bitmap
+    if (draw)
+    {
+        if (render_copy_palette(currentUpdate->palette))
+            memcpy(updates[currentUpdate == updates[0]]->palette, currentUpdate->palette, 512);
+        slowFrame = !rg_display_sync(false);
+        rg_display_submit(currentUpdate, 0);
+        currentUpdate = updates[currentUpdate == updates[0]]; // Swap
+        bitmap.data = currentUpdate->data;
+    }
+}
+
 static void options_handler(rg_gui_option_t *dest)
 {
     *dest++ = (rg_gui_option_t){0, _("Palette"), "-", RG_DIALOG_FLAG_NORMAL, &palette_update_cb};
@@ -104,6 +146,8 @@ void sms_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
@@ -116,6 +160,11 @@ void sms_main(void)
     updates[1] = rg_surface_create(SMS_WIDTH, SMS_HEIGHT, RG_PIXEL_PAL565_BE, MEM_FAST);
     currentUpdate = updates[0];
 
+    // The emulator's sound buffer isn't in a very convenient format (one stream per channel)
+    mixer = rg_audio_mixer_create(AUDIO_SAMPLE_RATE, 2);
+    psg_left = rg_audio_mixer_add_source(mixer, RG_AUDIO_SOURCE_LEFT, AUDIO_SAMPLE_RATE, 2.75f);
+    psg_right = rg_audio_mixer_add_source(mixer, RG_AUDIO_SOURCE_RIGHT, AUDIO_SAMPLE_RATE, 2.75f);
+
     system_reset_config();
     option.sndrate = AUDIO_SAMPLE_RATE;
     option.overscan = 0;
@@ -133,7 +182,7 @@ void sms_main(void)
     {
         void *data;
         size_t size;
-        if (!rg_storage_unzip_file(app->romPath, NULL, &data, &size, RG_FILE_ALIGN_16KB))
+        if (!rg_storage_unzip_file(app->romPath, "sms sg gg col rom", &data, &size, RG_FILE_ALIGN_16KB))
             RG_PANIC("ROM file unzipping failed!");
         if (!load_rom(data, RG_MAX(0x4000, size), size))
             RG_PANIC("ROM file loading failed!");
@@ -163,6 +212,7 @@ void sms_main(void)
     }
 
     rg_system_set_tick_rate((sms.display == DISPLAY_NTSC) ? FPS_NTSC : FPS_PAL);
+    rg_system_set_tick_pacing(true);
     app->frameskip = 0;
 
     int skipFrames = 0;
@@ -183,7 +233,7 @@ void sms_main(void)
 
         int64_t startTime = rg_system_timer();
         bool drawFrame = !skipFrames;
-        bool slowFrame = false;
+        slowFrame = false;
 
         input.pad[0] = 0x00;
         input.pad[1] = 0x00;
@@ -241,32 +291,15 @@ void sms_main(void)
             }
         }
 
-        system_frame(!drawFrame);
+        rg_emu_run_frame(&run_frame, drawFrame);
 
-        if (drawFrame)
-        {
-            if (render_copy_palette(currentUpdate->palette))
-                memcpy(updates[currentUpdate == updates[0]]->palette, currentUpdate->palette, 512);
-            slowFrame = !rg_display_sync(false);
-            rg_display_submit(currentUpdate, 0);
-            currentUpdate = updates[currentUpdate == updates[0]]; // Swap
-            bitmap.data = currentUpdate->data;
-        }
-
-        // The emulator's sound buffer isn't in a very convenient format, we must remix it.
-        size_t sample_count = snd.sample_count;
-        rg_audio_sample_t mixbuffer[sample_count];
-        for (size_t i = 0; i < sample_count; i++)
-        {
-            mixbuffer[i].left = snd.stream[0][i] * 2.75f;
-            mixbuffer[i].right = snd.stream[1][i] * 2.75f;
-        }
+        rg_audio_mixer_write(mixer, psg_left, snd.stream[STREAM_PSG_L], snd.sample_count);
+        rg_audio_mixer_write(mixer, psg_right, snd.stream[STREAM_PSG_R], snd.sample_count);
 
-        // Tick before submitting audio/syncing
+        // Tick before submitting audio/syncing (this is where we wait for the next frame)
         rg_system_tick(rg_system_timer() - startTime);
 
-        // Audio is used to pace emulation :)
-        rg_audio_submit(mixbuffer, sample_count);
+        rg_audio_mixer_submit(mixer, snd.sample_count);
 
         // See if we need to skip a frame to keep up
         if (skipFrames == 0)
@@ -70,6 +70,7 @@ static rg_app_t *app;
 static rg_surface_t *updates[2];
 static rg_surface_t *currentUpdate;
 static rg_audio_sample_t *audioBuffer;
+static rg_sram_t *sram;
 
 static bool apu_enabled = true;
 static bool lowpass_filter = false;
@@ -102,6 +103,27 @@ static bool load_state_handler(const char *filename)
     return S9xLoadState(filename);
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_storage_memopen(buffer, *size, "wb");
+    if (!fp)
+        return false;
+    bool success = S9xSaveStateFP(fp) && fseek(fp, 0, SEEK_END) == 0 && !ferror(fp);
+    *size = ftell(fp);
+    fclose(fp);
+    return success;
+}
+
+static bool load_state_mem_handler(const void *buffer, size_t size)
+{
+    FILE *fp = rg_storage_memopen((void *)buffer, size, "rb");
+    if (!fp)
+        return false;
+    bool success = S9xLoadStateFP(fp);
+    fclose(fp);
+    return success;
+}
+
 static bool reset_handler(bool hard)
 {
     S9xReset();
@@ -114,6 +136,11 @@ static void event_handler(int event, void *arg)
     {
         rg_display_submit(currentUpdate, 0);
     }
+    else if (event == RG_EVENT_SHUTDOWN)
+    {
+        rg_sram_close(sram);
+        sram = NULL;
+    }
 }
 
 static rg_gui_event_t apu_toggle_cb(rg_gui_option_t *option, rg_gui_event_t event)
@@ -297,6 +324,8 @@ void snes_main(void)
     const rg_handlers_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
         .event = &event_handler,
@@ -344,7 +373,7 @@ void snes_main(void)
 
     if (rg_extension_match(filename, "zip"))
     {
-        if (!rg_storage_unzip_file(filename, NULL, (void **)&Memory.ROM, &Memory.ROM_AllocSize, RG_FILE_USER_BUFFER))
+        if (!rg_storage_unzip_file(filename, "smc sfc", (void **)&Memory.ROM, &Memory.ROM_AllocSize, RG_FILE_USER_BUFFER))
             RG_PANIC("ROM file unzipping failed!");
         filename = NULL;
     }
@@ -352,6 +381,14 @@ void snes_main(void)
     if (!LoadROM(filename))
         RG_PANIC("ROM loading failed!");
 
+    // SRAM writes are spread across getset.c, it's simpler to let rg_sram spot the changes
+    if (Memory.SRAMMask)
+    {
+        char *sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, app->romPath);
+        sram = rg_sram_open(sramFile, Memory.SRAM, Memory.SRAMMask + 1, RG_SRAM_AUTODETECT);
+        free(sramFile);
+    }
+
 #ifdef USE_BLARGG_APU
     S9xSetSamplesAvailableCallback(S9xAudioCallback);
 #else
@@ -364,6 +401,7 @@ void snes_main(void)
     }
 
     rg_system_set_tick_rate(Memory.ROMFramesPerSecond);
+    rg_system_set_tick_pacing(true);
     app->frameskip = 3;
 
     bool menuCancelled = false;
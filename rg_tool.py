@@ -55,6 +55,12 @@ def run(cmd, cwd=None, check=True):
     return subprocess.run(cmd, shell=False, cwd=cwd, check=check)
 
 
+def parse_size(size):
+    units = {"K": 1024, "M": 1024 * 1024}
+    size = str(size).upper()
+    return int(size[:-1]) * units[size[-1]] if size[-1] in units else int(size, 0)
+
+
 def build_firmware(output_file, apps, fw_format="odroid-go", fatsize=0):
     print("Building firmware with: %s\n" % " ".join(apps))
     args = [MKFW_PY, output_file, f"{PROJECT_NAME} {PROJECT_VER}", PROJECT_ICON]
@@ -69,7 +75,7 @@ def build_firmware(output_file, apps, fw_format="odroid-go", fatsize=0):
     run(args)
 
 
-def build_image(output_file, apps, img_format="esp32", fatsize=0):
+def build_image(output_file, apps, img_format="esp32", fatsize=0, romcachesize=0):
     print("Building image with: %s\n" % " ".join(apps))
     image_data = bytearray(b"\xFF" * 0x10000)
     table_ota = 0
@@ -91,6 +97,11 @@ def build_image(output_file, apps, img_format="esp32", fatsize=0):
         # Use "vfs" label, same as MicroPython, in case the storage is to be shared with a MicroPython install
         table_csv.append("vfs, data, fat, %d, %s" % (len(image_data), fatsize))
 
+    if romcachesize:
+        # The launcher copies ROMs there and cores map them, so it must start on a 64KB MMU page
+        offset = len(image_data) + (parse_size(fatsize) if fatsize else 0)
+        table_csv.append("romcache, data, 0x40, %d, %s" % ((offset + 0xFFFF) & ~0xFFFF, romcachesize))
+
     print("Generating partition table...")
     with open("partitions.csv", "w") as f:
         f.write("\n".join(table_csv))
@@ -202,6 +213,9 @@ parser.add_argument(
 parser.add_argument(
     "--fatsize", help="Add FAT storage partition of provided size (500K, 5M,...) to the built image."
 )
+parser.add_argument(
+    "--romcachesize", help="Add ROM cache partition of provided size (2M, 4M,...) to the built image."
+)
 args = parser.parse_args()
 
 command = args.command
@@ -242,7 +256,7 @@ try:
     if command in ["build-img", "release", "install"]:
         print("=== Step: Packing ===\n")
         img_file = ("%s_%s_%s.img" % (PROJECT_NAME, PROJECT_VER, args.target)).lower()
-        build_image(img_file, apps, os.getenv("IMG_FORMAT", os.getenv("IDF_TARGET")), args.fatsize)
+        build_image(img_file, apps, os.getenv("IMG_FORMAT", os.getenv("IDF_TARGET")), args.fatsize, args.romcachesize)
 
     if command in ["install"]:
         print("=== Step: Flashing entire image to device ===\n")
@@ -0,0 +1,121 @@
+#!/bin/bash
+
+# Headless benchmark runner, see tools/build_sdl2.sh for requirements.
+# Usage: tools/bench_sdl2.sh <app> <rom> [frames] [input script] [frameskip]
+#   app: nes, gb, gbc, sms, gg, col, pce, lnx, snes, gw, gwenesis, fmsx, prboom-go
+#   input script: text file of `<frame> <key>[+<key>...]` lines (eg: `120 Start`)
+# The ROM is emulated as fast as possible for N frames without window or audio pacing
+# and the timing report (fps, us per frame, rg_stats_t) is printed at the end.
+# Binaries and logs go to $BENCH_DIR (default: $TMPDIR/retro-go-bench), never to the source tree.
+
+APP="$1"
+ROM="$2"
+FRAMES="${3:-1000}"
+INPUT="$4"
+FRAMESKIP="${5:--1}"
+
+if [ -z "$APP" ] || [ -z "$ROM" ]; then
+	echo "Usage: $0 <app> <rom> [frames] [input script] [frameskip]"
+	exit 1
+fi
+
+CC="gcc"
+CFLAGS="-O2 -no-pie -DRG_TARGET_SDL2 -DRETRO_GO -DCJSON_HIDE_SYMBOLS -DSDL_MAIN_HANDLED=1 -DRG_BUILD_INFO=\"SDL2-BENCH\" -Dapp_main=SDL_Main -DRG_ENABLE_BENCHMARK $(sdl2-config --cflags)"
+INCLUDES="-Icomponents/retro-go -Icomponents/retro-go/libs/cJSON -Icomponents/retro-go/libs/lodepng -Icomponents/retro-go/libs/miniz"
+SRCFILES="components/retro-go/*.c components/retro-go/drivers/audio/*.c components/retro-go/fonts/*.c
+		  components/retro-go/libs/cJSON/*.c components/retro-go/libs/lodepng/*.c components/retro-go/libs/miniz/*.c"
+LIBS="$(sdl2-config --libs) -lstdc++ -lm"
+
+OUT="${BENCH_DIR:-${TMPDIR:-/tmp}/retro-go-bench}"
+mkdir -p "$OUT" || exit 1
+
+case "$APP" in
+	gwenesis|fmsx|prboom-go) PROJECT="$APP" ;;
+	*) PROJECT="retro-core" ;;
+esac
+
+# SKIP_BUILD=1 reuses the previous build, useful when running many ROMs in a row
+if [ -n "$SKIP_BUILD" ] && [ -f "$OUT/$PROJECT.exe" ]; then
+	echo "Using existing $OUT/$PROJECT.exe"
+else
+case "$PROJECT" in
+gwenesis)
+	$CC $CFLAGS $INCLUDES \
+		-Igwenesis/components/gwenesis \
+		-Igwenesis/components/gwenesis/src/bus \
+		-Igwenesis/components/gwenesis/src/cpus/M68K \
+		-Igwenesis/components/gwenesis/src/cpus/Z80 \
+		-Igwenesis/components/gwenesis/src/io \
+		-Igwenesis/components/gwenesis/src/savestate \
+		-Igwenesis/components/gwenesis/src/sound \
+		-Igwenesis/components/gwenesis/src/vdp \
+		$SRCFILES \
+		gwenesis/components/gwenesis/src/*/*.c \
+		gwenesis/components/gwenesis/src/cpus/*/*.c \
+		gwenesis/main/*.c \
+		$LIBS -o "$OUT/$PROJECT.exe" || exit 1
+	;;
+fmsx)
+	FMSX_FLAGS="-DBPS16 -DUNIX -DLSB_FIRST -DNARROW -Ifmsx/components/fmsx -Ifmsx/components/fmsx/src/EMULib
+		-Ifmsx/components/fmsx/src/fMSX -Ifmsx/components/fmsx/src/Z80 -ffunction-sections -Wl,--gc-sections"
+	# fMSX's own sources must be built with msxfix.h force-included (and some of EMULib is unused)
+	mkdir -p "$OUT/fmsx-obj"
+	for f in fmsx/components/fmsx/src/*/*.c; do
+		$CC $CFLAGS $INCLUDES $FMSX_FLAGS -include msxfix.h -c $f -o "$OUT/fmsx-obj"/$(basename $f .c).o || exit 1
+	done
+	$CC $CFLAGS $INCLUDES $FMSX_FLAGS \
+		$SRCFILES \
+		fmsx/components/fmsx/*.c \
+		fmsx/main/*.c \
+		"$OUT/fmsx-obj"/*.o \
+		$LIBS -o "$OUT/$PROJECT.exe" || exit 1
+	rm -rf "$OUT/fmsx-obj"
+	;;
+prboom-go)
+	$CC $CFLAGS $INCLUDES -DHAVE_CONFIG_H \
+		-Iprboom-go/components/prboom \
+		-Iprboom-go/main \
+		$SRCFILES \
+		$(ls prboom-go/components/prboom/*.c | grep -v d_server.c) \
+		prboom-go/main/*.c \
+		$LIBS -o "$OUT/$PROJECT.exe" || exit 1
+	;;
+retro-core)
+	$CC $CFLAGS $INCLUDES \
+		-Iretro-core/components/gnuboy \
+		-Iretro-core/components/gw-emulator/src \
+		-Iretro-core/components/gw-emulator/src/cpus \
+		-Iretro-core/components/gw-emulator/src/gw_sys \
+		-Iretro-core/components/handy \
+		-Iretro-core/components/nofrendo \
+		-Iretro-core/components/pce-go \
+		-Iretro-core/components/snes9x \
+		-Iretro-core/components/snes9x/src \
+		-Iretro-core/components/smsplus \
+		-Iretro-core/main \
+		$SRCFILES \
+		retro-core/components/gnuboy/*.c \
+		retro-core/components/gw-emulator/src/*.c \
+		retro-core/components/gw-emulator/src/cpus/*.c \
+		retro-core/components/gw-emulator/src/gw_sys/*.c \
+		retro-core/components/handy/*.cpp \
+		retro-core/components/nofrendo/mappers/*.c \
+		retro-core/components/nofrendo/nes/*.c \
+		retro-core/components/nofrendo/*.c \
+		retro-core/components/pce-go/*.c \
+		retro-core/components/snes9x/src/*.c \
+		retro-core/components/smsplus/*.c \
+		retro-core/components/smsplus/cpu/*.c \
+		retro-core/components/smsplus/sound/*.c \
+		retro-core/main/*.c \
+		retro-core/main/*.cpp \
+		$LIBS -o "$OUT/$PROJECT.exe" || exit 1
+	;;
+esac
+fi
+
+echo "Running $PROJECT ($APP) for $FRAMES frames..."
+SDL_VIDEODRIVER=offscreen SDL_AUDIODRIVER=dummy \
+RG_BENCH_APP="$APP" RG_BENCH_ROM="$ROM" RG_BENCH_FRAMES="$FRAMES" RG_BENCH_INPUT="$INPUT" RG_BENCH_FRAMESKIP="$FRAMESKIP" \
+	"$OUT/$PROJECT.exe" > "$OUT/$PROJECT.log" 2>&1
+grep -a "RGD:BENCH" "$OUT/$PROJECT.log" || (echo "Benchmark failed, see $OUT/$PROJECT.log"; exit 1)
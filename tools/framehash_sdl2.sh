@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Frame-hash regression runner, built on top of tools/bench_sdl2.sh.
+# Usage: tools/framehash_sdl2.sh <app> <rom> <golden file> [frames] [input script] [interval]
+#        tools/framehash_sdl2.sh blargg <golden dir> [frames]
+# Every <interval> frames (default 60) the CRC of the last submitted frame and of all the audio
+# since the previous line is written. If the golden file doesn't exist it is recorded, otherwise
+# the run must match it exactly. The second form runs every ROM in gnuboy's blargg.zip.
+
+run_one()
+{
+	local APP="$1" ROM="$2" GOLDEN="$3" FRAMES="${4:-600}" INPUT="$5" INTERVAL="${6:-60}"
+	local OUTPUT="${BENCH_DIR:-${TMPDIR:-/tmp}/retro-go-bench}/framehash-$$.txt"
+
+	RG_BENCH_HASH="$OUTPUT" RG_BENCH_HASH_INTERVAL="$INTERVAL" \
+		tools/bench_sdl2.sh "$APP" "$ROM" "$FRAMES" "$INPUT" > /dev/null || { echo "FAIL: $ROM (crashed)"; return 1; }
+
+	if [ ! -f "$GOLDEN" ]; then
+		mv "$OUTPUT" "$GOLDEN"
+		echo "RECORDED: $ROM"
+	elif cmp -s "$OUTPUT" "$GOLDEN"; then
+		rm -f "$OUTPUT"
+		echo "PASS: $ROM"
+	else
+		echo "FAIL: $ROM (first mismatch: frame $(diff "$GOLDEN" "$OUTPUT" | grep '^>' | head -n1 | cut -d' ' -f2))"
+		rm -f "$OUTPUT"
+		return 1
+	fi
+}
+
+if [ "$1" == "blargg" ]; then
+	if [ -z "$2" ]; then
+		echo "Usage: $0 blargg <golden dir> [frames]"
+		exit 1
+	fi
+	CORPUS="$(mktemp -d)"
+	unzip -q retro-core/components/gnuboy/tests/blargg.zip -d "$CORPUS" || exit 1
+	mkdir -p "$2"
+	FAILED=0
+	FIRST=1
+	while IFS= read -r ROM; do
+		# Only build on the first run, golden files are named after the path inside the zip
+		GOLDEN="$2/$(echo "${ROM#$CORPUS/}" | tr '/ ' '__').txt"
+		SKIP_BUILD=$([ $FIRST == 1 ] && echo "$SKIP_BUILD" || echo 1) run_one gbc "$ROM" "$GOLDEN" "${3:-600}" || FAILED=1
+		FIRST=0
+	done < <(find "$CORPUS" -name "*.gb" | sort)
+	rm -rf "$CORPUS"
+	exit $FAILED
+fi
+
+if [ -z "$1" ] || [ -z "$2" ] || [ -z "$3" ]; then
+	echo "Usage: $0 <app> <rom> <golden file> [frames] [input script] [interval]"
+	exit 1
+fi
+
+run_one "$@"